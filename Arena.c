@@ -0,0 +1,116 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include "Arena.h"
+
+#define ARENA_ALIGNMENT 16
+/* Blocks stop doubling at this size, larger allocations get a block of their own */
+#define ARENA_MAX_BLOCK (1 << 20)
+
+static size_t Arena_Align(size_t size)
+{
+	return (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+}
+
+static uint8_t* Arena_BlockData(ArenaBlock* block)
+{
+	return (uint8_t*)block + Arena_Align(sizeof(ArenaBlock));
+}
+
+Arena* Arena_Make(size_t blockSize)
+{
+	Arena* arena = calloc(1, sizeof(Arena));
+	assert(arena != NULL);
+	arena->blockSize = blockSize > 0 ? blockSize : 4096;
+
+	return arena;
+}
+
+void Arena_Free(Arena* toFree)
+{
+	assert(toFree != NULL);
+	ArenaBlock* block = toFree->current;
+	while(block != NULL)
+	{
+		ArenaBlock* previous = block->previous;
+		free(block);
+		block = previous;
+	}
+	free(toFree);
+}
+
+void* Arena_Allocate(Arena* arena, size_t size)
+{
+	assert(arena != NULL);
+
+	size = Arena_Align(size);
+	ArenaBlock* block = arena->current;
+	if(size > ARENA_MAX_BLOCK / 2 && (block == NULL || block->capacity - block->used < size))
+	{
+		// a block sized to fit, linked in behind the current block so the room left there is still used
+		block = calloc(1, Arena_Align(sizeof(ArenaBlock)) + size);
+		assert(block != NULL);
+		block->capacity = size;
+		block->used = size;
+		if(arena->current != NULL)
+		{
+			block->previous = arena->current->previous;
+			arena->current->previous = block;
+		}
+		else
+			arena->current = block;
+		arena->blocksAllocated += 1;
+		arena->bytesAllocated += size;
+
+		// never the current block, so it can not be grown in place
+		arena->lastAllocation = NULL;
+		return Arena_BlockData(block);
+	}
+
+	if(block == NULL || block->capacity - block->used < size)
+	{
+		// blocks are calloc'd, so memory handed out is already zeroed
+		size_t capacity = arena->blockSize;
+		while(capacity < size)
+			capacity *= 2;
+		arena->blockSize = 2 * capacity < ARENA_MAX_BLOCK ? 2 * capacity : ARENA_MAX_BLOCK;
+
+		block = calloc(1, Arena_Align(sizeof(ArenaBlock)) + capacity);
+		assert(block != NULL);
+		block->capacity = capacity;
+		block->previous = arena->current;
+		arena->current = block;
+		arena->blocksAllocated += 1;
+	}
+
+	void* allocation = Arena_BlockData(block) + block->used;
+	block->used += size;
+	arena->bytesAllocated += size;
+	arena->lastAllocation = allocation;
+	return allocation;
+}
+
+void* Arena_Reallocate(Arena* arena, void* allocation, size_t oldSize, size_t newSize)
+{
+	assert(arena != NULL);
+
+	if(allocation == NULL)
+		return Arena_Allocate(arena, newSize);
+	if(newSize <= oldSize)
+		return allocation;
+
+	ArenaBlock* block = arena->current;
+	size_t oldAligned = Arena_Align(oldSize);
+	size_t newAligned = Arena_Align(newSize);
+	if(allocation == arena->lastAllocation && block->capacity - block->used >= newAligned - oldAligned)
+	{
+		// grow in place, the bytes past the end of the block are still zeroed
+		block->used += newAligned - oldAligned;
+		arena->bytesAllocated += newAligned - oldAligned;
+		return allocation;
+	}
+
+	void* grown = Arena_Allocate(arena, newSize);
+	memcpy(grown, allocation, oldSize);
+	return grown;
+}
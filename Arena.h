@@ -0,0 +1,68 @@
+/** @file Arena.h
+ *	@author Bandi Enkh-Amgalan
+ *  @brief Declaration of Arena struct and supporting functions
+ *
+ *  Arena is a bump allocator for state that lives as long as a FATImage. Allocations
+ *  are carved out of large blocks and are never freed individually; freeing the arena
+ *  releases every allocation at once. */
+
+#pragma once
+
+#include <stdlib.h>
+
+/* Block of memory that allocations are carved out of */
+typedef struct ArenaBlock
+{
+	struct ArenaBlock* previous;
+	size_t capacity;
+	size_t used;
+} ArenaBlock;
+
+/* Bump allocator made up of a list of blocks, where each block is twice as large as the last up to 1 MB.
+ * Allocations over half of that which do not fit the current block get a block of their own. */
+typedef struct
+{
+	ArenaBlock* current;
+	void* lastAllocation;
+	size_t blockSize;
+	size_t blocksAllocated;
+	size_t bytesAllocated;
+} Arena;
+
+/** @brief	Allocate and initialize an empty Arena on the heap
+ *
+ *			Caller must free the Arena by calling Arena_Free(), which also releases
+ *			all memory allocated from the arena. 
+ *
+ *  @param 	blockSize	size of the first block in bytes, later blocks double in size up to 1 MB
+ *  @return pointer to dynamically allocated Arena struct
+ */
+Arena* Arena_Make(size_t blockSize);
+
+/** @brief	Free an Arena and all memory allocated from it
+ *
+ *  @param 	arena */
+void Arena_Free(Arena* arena);
+
+/** @brief	Allocate zeroed memory from an Arena
+ *
+ *			The returned memory is suitably aligned for any type and stays valid
+ *			until the arena is freed. 
+ *
+ *  @param 	arena
+ *  @param 	size	size of allocation in bytes
+ *  @return pointer to zeroed memory */
+void* Arena_Allocate(Arena* arena, size_t size);
+
+/** @brief	Grow an allocation made from an Arena
+ *
+ *			If the allocation is the most recent allocation and the current block has room,
+ *			it is grown in place, otherwise a new allocation is made and the contents are copied over.
+ *			Any new bytes are zeroed. 
+ *
+ *  @param 	arena
+ *  @param 	allocation	allocation to grow, NULL to make a new allocation
+ *  @param 	oldSize		current size of allocation in bytes
+ *  @param 	newSize		new size of allocation in bytes
+ *  @return pointer to grown allocation */
+void* Arena_Reallocate(Arena* arena, void* allocation, size_t oldSize, size_t newSize);
@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include "greatest/greatest.h"
+#include "Arena.h"
+
+TEST Arena_Allocate_ReturnsZeroedAlignedMemory()
+{
+	Arena* arena = Arena_Make(64);
+	uint8_t* one = Arena_Allocate(arena, 3);
+	uint8_t* two = Arena_Allocate(arena, 40);
+	ASSERT_EQ((uintptr_t)one % 16, 0);
+	ASSERT_EQ((uintptr_t)two % 16, 0);
+	ASSERT(two >= one + 3);
+	for(size_t index = 0 ; index < 40 ; ++index)
+		ASSERT_EQ(two[index], 0);
+	Arena_Free(arena);
+	PASS();
+}
+
+TEST Arena_Allocate_GrowsBlocksGeometrically()
+{
+	Arena* arena = Arena_Make(64);
+	for(size_t index = 0 ; index < 1000 ; ++index)
+		Arena_Allocate(arena, 64);
+	ASSERT_EQ(arena->bytesAllocated, 64000);
+	ASSERT(arena->blocksAllocated <= 12);
+	Arena_Free(arena);
+	PASS();
+}
+
+TEST Arena_Allocate_LargeAllocationsGetBlocksOfTheirOwn()
+{
+	Arena* arena = Arena_Make(64 * 1024);
+	uint8_t* small = Arena_Allocate(arena, 16);
+	uint8_t* large = Arena_Allocate(arena, 8 << 20);
+	uint8_t* next = Arena_Allocate(arena, 16);
+	ASSERT_EQ(large[(8 << 20) - 1], 0);
+
+	// the block of the small allocations is still filled, and block sizes stop doubling
+	ASSERT_EQ(next, small + 16);
+	ASSERT_EQ(arena->blocksAllocated, 2);
+	ASSERT_EQ(arena->blockSize, 128 * 1024);
+	for(size_t index = 0 ; index < 64 ; ++index)
+		Arena_Allocate(arena, 64 * 1024);
+	ASSERT(arena->blockSize <= 1 << 20);
+	ASSERT_EQ(arena->bytesAllocated, (8 << 20) + 32 + 64 * 64 * 1024);
+	Arena_Free(arena);
+	PASS();
+}
+
+TEST Arena_Reallocate_LastAllocationGrowsInPlace()
+{
+	Arena* arena = Arena_Make(1024);
+	uint8_t* allocation = Arena_Allocate(arena, 16);
+	allocation[15] = 42;
+	uint8_t* grown = Arena_Reallocate(arena, allocation, 16, 64);
+	ASSERT_EQ(grown, allocation);
+	ASSERT_EQ(grown[15], 42);
+	ASSERT_EQ(grown[63], 0);
+	Arena_Free(arena);
+	PASS();
+}
+
+TEST Arena_Reallocate_OlderAllocationIsCopied()
+{
+	Arena* arena = Arena_Make(1024);
+	uint8_t* allocation = Arena_Allocate(arena, 16);
+	allocation[0] = 42;
+	Arena_Allocate(arena, 16);
+	uint8_t* grown = Arena_Reallocate(arena, allocation, 16, 64);
+	ASSERT(grown != allocation);
+	ASSERT_EQ(grown[0], 42);
+	ASSERT_EQ(grown[63], 0);
+	Arena_Free(arena);
+	PASS();
+}
+
+SUITE(ArenaTest)
+{
+	RUN_TEST(Arena_Allocate_ReturnsZeroedAlignedMemory);
+	RUN_TEST(Arena_Allocate_GrowsBlocksGeometrically);
+	RUN_TEST(Arena_Allocate_LargeAllocationsGetBlocksOfTheirOwn);
+	RUN_TEST(Arena_Reallocate_LastAllocationGrowsInPlace);
+	RUN_TEST(Arena_Reallocate_OlderAllocationIsCopied);
+}
@@ -0,0 +1,126 @@
+#include <assert.h>
+#include "Bitset.h"
+
+#define BITSET_WORD_BITS 64
+
+void Bitset_Initialize(Bitset* bitset, Arena* arena, size_t length)
+{
+	assert(bitset != NULL);
+	assert(arena != NULL);
+
+	size_t words = (length + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+	bitset->words = Arena_Allocate(arena, words * sizeof(uint64_t));
+	bitset->length = length;
+}
+
+void Bitset_Set(Bitset* bitset, size_t index)
+{
+	assert(bitset != NULL);
+	assert(index < bitset->length);
+	bitset->words[index / BITSET_WORD_BITS] |= (uint64_t)1 << (index % BITSET_WORD_BITS);
+}
+
+void Bitset_Clear(Bitset* bitset, size_t index)
+{
+	assert(bitset != NULL);
+	assert(index < bitset->length);
+	bitset->words[index / BITSET_WORD_BITS] &= ~((uint64_t)1 << (index % BITSET_WORD_BITS));
+}
+
+bool Bitset_Test(Bitset* bitset, size_t index)
+{
+	assert(bitset != NULL);
+	assert(index < bitset->length);
+	return (bitset->words[index / BITSET_WORD_BITS] >> (index % BITSET_WORD_BITS)) & 1;
+}
+
+void Bitset_SetRange(Bitset* bitset, size_t start, size_t length)
+{
+	assert(bitset != NULL);
+	assert(start + length <= bitset->length);
+
+	size_t end = start + length;
+	while(start < end)
+	{
+		size_t bit = start % BITSET_WORD_BITS;
+		size_t count = BITSET_WORD_BITS - bit;
+		if(count > end - start)
+			count = end - start;
+
+		uint64_t mask = count == BITSET_WORD_BITS ? ~(uint64_t)0 : (((uint64_t)1 << count) - 1) << bit;
+		bitset->words[start / BITSET_WORD_BITS] |= mask;
+		start += count;
+	}
+}
+
+size_t Bitset_Count(Bitset* bitset)
+{
+	assert(bitset != NULL);
+
+	size_t count = 0;
+	size_t words = (bitset->length + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+	for(size_t index = 0 ; index < words ; ++index)
+		count += __builtin_popcountll(bitset->words[index]);
+	return count;
+}
+
+size_t Bitset_CountAndNot(Bitset* bitset, Bitset* exclude)
+{
+	assert(bitset != NULL);
+	assert(exclude != NULL);
+	assert(bitset->length == exclude->length);
+
+	size_t count = 0;
+	size_t words = (bitset->length + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+	for(size_t index = 0 ; index < words ; ++index)
+		count += __builtin_popcountll(bitset->words[index] & ~exclude->words[index]);
+	return count;
+}
+
+size_t Bitset_NextAndNot(Bitset* bitset, Bitset* exclude, size_t from)
+{
+	assert(bitset != NULL);
+	assert(exclude != NULL);
+	assert(bitset->length == exclude->length);
+
+	if(from >= bitset->length)
+		return bitset->length;
+
+	size_t words = (bitset->length + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+	size_t word = from / BITSET_WORD_BITS;
+	uint64_t bits = (bitset->words[word] & ~exclude->words[word]) & (~(uint64_t)0 << (from % BITSET_WORD_BITS));
+	while(bits == 0)
+	{
+		if(++word >= words)
+			return bitset->length;
+		bits = bitset->words[word] & ~exclude->words[word];
+	}
+
+	size_t index = word * BITSET_WORD_BITS + __builtin_ctzll(bits);
+	return index < bitset->length ? index : bitset->length;
+}
+
+
+size_t Bitset_RunEndAndNot(Bitset* bitset, Bitset* exclude, size_t from)
+{
+	assert(bitset != NULL);
+	assert(exclude != NULL);
+	assert(bitset->length == exclude->length);
+
+	if(from >= bitset->length)
+		return bitset->length;
+
+	// same sweep as Bitset_NextAndNot, looking for clear bits instead
+	size_t words = (bitset->length + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+	size_t word = from / BITSET_WORD_BITS;
+	uint64_t bits = ~(bitset->words[word] & ~exclude->words[word]) & (~(uint64_t)0 << (from % BITSET_WORD_BITS));
+	while(bits == 0)
+	{
+		if(++word >= words)
+			return bitset->length;
+		bits = ~(bitset->words[word] & ~exclude->words[word]);
+	}
+
+	size_t index = word * BITSET_WORD_BITS + __builtin_ctzll(bits);
+	return index < bitset->length ? index : bitset->length;
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+/** @file Bitset.h
+ *	@author Bandi Enkh-Amgalan
+ *  @brief Declaration of Bitset struct and supporting functions
+ *
+ *  Bitset is a packed array of bits, one per cluster, used to answer questions such as
+ *  "which clusters are unreferenced" with word-at-a-time bit operations. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "Arena.h"
+
+/* Packed array of length bits, stored in 64-bit words */
+typedef struct
+{
+	uint64_t* words;
+	size_t length;
+} Bitset;
+
+/** @brief	Allocate the words of an empty Bitset from an Arena
+ *
+ *  @param 	bitset
+ *  @param 	arena
+ *  @param 	length	number of bits */
+void Bitset_Initialize(Bitset* bitset, Arena* arena, size_t length);
+
+/** @brief	Set a bit
+ *
+ *  @param 	bitset
+ *  @param 	index	must be less than bitset length */
+void Bitset_Set(Bitset* bitset, size_t index);
+
+/** @brief	Clear a bit
+ *
+ *  @param 	bitset
+ *  @param 	index	must be less than bitset length */
+void Bitset_Clear(Bitset* bitset, size_t index);
+
+/** @brief	Check if a bit is set
+ *
+ *  @param 	bitset
+ *  @param 	index	must be less than bitset length
+ *  @return true if bit is set, false otherwise */
+bool Bitset_Test(Bitset* bitset, size_t index);
+
+/** @brief	Set a range of bits, a word at a time
+ *
+ *  @param 	bitset
+ *  @param 	start	first bit to set
+ *  @param 	length	number of bits to set, start + length must not exceed bitset length */
+void Bitset_SetRange(Bitset* bitset, size_t start, size_t length);
+
+/** @brief	Count set bits
+ *
+ *  @param 	bitset
+ *  @return number of set bits */
+size_t Bitset_Count(Bitset* bitset);
+
+/** @brief	Count bits set in one Bitset but not in another
+ *
+ *  @param 	bitset
+ *  @param 	exclude	Bitset of the same length
+ *  @return number of bits set in bitset and clear in exclude */
+size_t Bitset_CountAndNot(Bitset* bitset, Bitset* exclude);
+
+/** @brief	Find the next bit set in one Bitset but not in another
+ *
+ *  @param 	bitset
+ *  @param 	exclude	Bitset of the same length
+ *  @param 	from	index to start searching from
+ *  @return index of the first bit at or after from that is set in bitset and clear in exclude, bitset length if there is none */
+size_t Bitset_NextAndNot(Bitset* bitset, Bitset* exclude, size_t from);
+
+
+/** @brief	Find the end of a run of bits set in one Bitset but not in another
+ *
+ *  @param 	bitset
+ *  @param 	exclude	Bitset of the same length
+ *  @param 	from	index to start searching from
+ *  @return index of the first bit at or after from that is clear in bitset or set in exclude, bitset length if there is none */
+size_t Bitset_RunEndAndNot(Bitset* bitset, Bitset* exclude, size_t from);
\ No newline at end of file
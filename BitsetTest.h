@@ -0,0 +1,84 @@
+#include "greatest/greatest.h"
+#include "Bitset.h"
+
+TEST Bitset_SetClearTest_Success()
+{
+	Arena* arena = Arena_Make(1024);
+	Bitset bitset;
+	Bitset_Initialize(&bitset, arena, 130);
+	ASSERT_EQ(Bitset_Count(&bitset), 0);
+	Bitset_Set(&bitset, 0);
+	Bitset_Set(&bitset, 64);
+	Bitset_Set(&bitset, 129);
+	ASSERT(Bitset_Test(&bitset, 0));
+	ASSERT(Bitset_Test(&bitset, 64));
+	ASSERT(Bitset_Test(&bitset, 129));
+	ASSERT_FALSE(Bitset_Test(&bitset, 1));
+	ASSERT_EQ(Bitset_Count(&bitset), 3);
+	Bitset_Clear(&bitset, 64);
+	ASSERT_FALSE(Bitset_Test(&bitset, 64));
+	ASSERT_EQ(Bitset_Count(&bitset), 2);
+	Arena_Free(arena);
+	PASS();
+}
+
+TEST Bitset_SetRange_SpansWords()
+{
+	Arena* arena = Arena_Make(1024);
+	Bitset bitset;
+	Bitset_Initialize(&bitset, arena, 300);
+	Bitset_SetRange(&bitset, 60, 150);
+	ASSERT_EQ(Bitset_Count(&bitset), 150);
+	ASSERT_FALSE(Bitset_Test(&bitset, 59));
+	ASSERT(Bitset_Test(&bitset, 60));
+	ASSERT(Bitset_Test(&bitset, 128));
+	ASSERT(Bitset_Test(&bitset, 209));
+	ASSERT_FALSE(Bitset_Test(&bitset, 210));
+	Arena_Free(arena);
+	PASS();
+}
+
+TEST Bitset_NextAndNot_ReturnsIndicesInOrder()
+{
+	Arena* arena = Arena_Make(1024);
+	Bitset bitset, exclude;
+	Bitset_Initialize(&bitset, arena, 200);
+	Bitset_Initialize(&exclude, arena, 200);
+	Bitset_SetRange(&bitset, 3, 5);
+	Bitset_Set(&bitset, 150);
+	Bitset_Set(&exclude, 5);
+	ASSERT_EQ(Bitset_CountAndNot(&bitset, &exclude), 5);
+
+	size_t expected[] = { 3, 4, 6, 7, 150 };
+	size_t found = 0;
+	for(size_t index = Bitset_NextAndNot(&bitset, &exclude, 0) ; index < bitset.length ; index = Bitset_NextAndNot(&bitset, &exclude, index + 1))
+		ASSERT_EQ(index, expected[found++]);
+	ASSERT_EQ(found, 5);
+	Arena_Free(arena);
+	PASS();
+}
+
+TEST Bitset_RunEndAndNot_FindsEndOfRuns()
+{
+	Arena* arena = Arena_Make(1024);
+	Bitset bitset, exclude;
+	Bitset_Initialize(&bitset, arena, 200);
+	Bitset_Initialize(&exclude, arena, 200);
+	Bitset_SetRange(&bitset, 10, 120);
+	Bitset_Set(&exclude, 100);
+	Bitset_SetRange(&bitset, 190, 10);
+	ASSERT_EQ(Bitset_RunEndAndNot(&bitset, &exclude, 10), 100);
+	ASSERT_EQ(Bitset_RunEndAndNot(&bitset, &exclude, 101), 130);
+	ASSERT_EQ(Bitset_RunEndAndNot(&bitset, &exclude, 190), 200);
+	ASSERT_EQ(Bitset_RunEndAndNot(&bitset, &exclude, 5), 5);
+	Arena_Free(arena);
+	PASS();
+}
+
+SUITE(BitsetTest)
+{
+	RUN_TEST(Bitset_SetClearTest_Success);
+	RUN_TEST(Bitset_SetRange_SpansWords);
+	RUN_TEST(Bitset_NextAndNot_ReturnsIndicesInOrder);
+	RUN_TEST(Bitset_RunEndAndNot_FindsEndOfRuns);
+}
@@ -12,54 +12,70 @@ ClusterChain* ClusterChain_Make()
 void ClusterChain_Free(ClusterChain* toFree)
 {
 	assert(toFree != NULL);
-	ClusterChain_FreeNodes(toFree);
+	ClusterChain_FreeExtents(toFree);
 	free(toFree);
 }
 
-void ClusterChain_FreeNodes(ClusterChain* toFree)
+void ClusterChain_FreeExtents(ClusterChain* toFree)
 {
 	assert(toFree != NULL);
-	ClusterChainNode* current = toFree->head;
-	while(current != NULL)
-	{
-		ClusterChainNode* next = current->next;
-		free(current);
-		current = next;
-	}
-	toFree->head = toFree->tail = NULL;
+	if(toFree->arena == NULL)
+		free(toFree->extents);
+	toFree->extents = NULL;
+	toFree->extentsLength = toFree->extentsCapacity = 0;
 	toFree->length = 0;
 }
 
-void ClusterChain_Append(ClusterChain* chain, size_t index)
+void ClusterChain_Reserve(ClusterChain* chain, size_t extentsCapacity)
 {
 	assert(chain != NULL);
-	ClusterChainNode* node = calloc(1, sizeof(ClusterChainNode));
-	assert(node != NULL);
-	node->index = index;
-	node->chain = chain;
 
-	if(chain->length == 0)
-	{
-		chain->head = chain->tail = node;
-	}
+	if(extentsCapacity <= chain->extentsCapacity)
+		return;
+
+	if(chain->arena != NULL)
+		chain->extents = Arena_Reallocate(chain->arena, chain->extents, chain->extentsCapacity * sizeof(ClusterExtent), extentsCapacity * sizeof(ClusterExtent));
 	else
+		chain->extents = realloc(chain->extents, extentsCapacity * sizeof(ClusterExtent));
+	assert(chain->extents != NULL);
+	chain->extentsCapacity = extentsCapacity;
+}
+
+void ClusterChain_Append(ClusterChain* chain, size_t index)
+{
+	assert(chain != NULL);
+
+	if(chain->extentsLength > 0)
 	{
-		chain->tail->next = node;
-		chain->tail = node;
+		ClusterExtent* last = chain->extents + (chain->extentsLength - 1);
+		if(last->start + last->length == index)
+		{
+			// index continues the last run
+			last->length += 1;
+			++(chain->length);
+			return;
+		}
 	}
 
+	// most chains are a single run, and arena extents of the chain being built grow in place
+	if(chain->extentsLength >= chain->extentsCapacity)
+		ClusterChain_Reserve(chain, chain->extentsCapacity > 0 ? 2 * chain->extentsCapacity : chain->arena != NULL ? 1 : 4);
+
+	chain->extents[chain->extentsLength].start = index;
+	chain->extents[chain->extentsLength].length = 1;
+	++(chain->extentsLength);
 	++(chain->length);
 }
 
-bool ClusterChain_SizeMatchesDirectoryEntry(ClusterChain* chain, size_t sectorSize)
+bool ClusterChain_SizeMatchesDirectoryEntry(ClusterChain* chain, size_t clusterSize)
 {
 	assert(chain != NULL);
 
-	if(chain->directoryEntry == NULL)
+	if(chain->directoryEntry == NULL || DirectoryEntry_IsSubdirectory(chain->directoryEntry))
 		return true;
 
-	size_t minSize = (chain->length - 1) * sectorSize;
-	size_t maxSize = chain->length * sectorSize;
+	size_t minSize = (chain->length - 1) * clusterSize;
+	size_t maxSize = chain->length * clusterSize;
 
 	return chain->directoryEntry->fileSize >= minSize && chain->directoryEntry->fileSize <= maxSize;
 }
@@ -70,30 +86,80 @@ void ClusterChain_Truncate(ClusterChain* chain, size_t newLength)
 
 	if(newLength < chain->length)
 	{
-		ClusterChainNode* node = chain->head;
-		size_t traversed = 1;
-		while(node)
+		size_t kept = 0;
+		size_t extent = 0;
+		for( ; extent < chain->extentsLength && kept < newLength ; ++extent)
 		{
-			if(traversed == newLength)
-			{
-				ClusterChainNode* next = node->next;
-				node->next = NULL;
-				node = next;
-			}
-			else if(traversed > newLength)
-			{
-				ClusterChainNode* next = node->next;
-				free(node);
-				node = next;
-			}
-			else
-			{
-				node = node->next;
-			}
-			
-			traversed++;
+			ClusterExtent* current = chain->extents + extent;
+			if(kept + current->length > newLength)
+				current->length = newLength - kept;
+			kept += current->length;
 		}
 
+		chain->extentsLength = extent;
 		chain->length = newLength;
 	}
-}
\ No newline at end of file
+}
+
+size_t ClusterChain_Head(ClusterChain* chain)
+{
+	assert(chain != NULL);
+	assert(chain->length > 0);
+	return chain->extents[0].start;
+}
+
+size_t ClusterChain_Tail(ClusterChain* chain)
+{
+	assert(chain != NULL);
+	assert(chain->length > 0);
+	ClusterExtent* last = chain->extents + (chain->extentsLength - 1);
+	return last->start + last->length - 1;
+}
+
+size_t ClusterChain_IndexAt(ClusterChain* chain, size_t position)
+{
+	assert(chain != NULL);
+	assert(position < chain->length);
+
+	ClusterExtent* extent = chain->extents;
+	while(position >= extent->length)
+	{
+		position -= extent->length;
+		++extent;
+	}
+	return extent->start + position;
+}
+
+ClusterChainIterator ClusterChain_Begin(ClusterChain* chain)
+{
+	assert(chain != NULL);
+
+	ClusterChainIterator iterator = { chain, 0, 0, 0 };
+	if(chain->extentsLength > 0)
+		iterator.index = chain->extents[0].start;
+	return iterator;
+}
+
+bool ClusterChainIterator_IsValid(ClusterChainIterator* iterator)
+{
+	assert(iterator != NULL);
+	return iterator->extent < iterator->chain->extentsLength;
+}
+
+void ClusterChainIterator_Next(ClusterChainIterator* iterator)
+{
+	assert(iterator != NULL);
+	assert(ClusterChainIterator_IsValid(iterator));
+
+	ClusterExtent* extent = iterator->chain->extents + iterator->extent;
+	if(++(iterator->offset) < extent->length)
+	{
+		++(iterator->index);
+		return;
+	}
+
+	++(iterator->extent);
+	iterator->offset = 0;
+	if(ClusterChainIterator_IsValid(iterator))
+		iterator->index = extent[1].start;
+}
@@ -2,37 +2,48 @@
  *	@author Bandi Enkh-Amgalan
  *  @brief Declaration of ClusterChain struct and supporting functions
  *
- *  ClusterChain is a linked list specialized for storing chains of cluster indices
- *  parsed from File Allocation Tables. */
+ *  ClusterChain is a list specialized for storing chains of cluster indices
+ *  parsed from File Allocation Tables. Consecutive indices are stored as a single
+ *  extent (start, length), so contiguous files take up a single array element. */
 
 #pragma once
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include "Arena.h"
 #include "DirectoryEntry.h"
 
-struct ClusterChain;
-
-/* Node in a CLusterChain linked list */
-typedef struct ClusterChainNode
+/* Run of consecutive cluster indices in a ClusterChain */
+typedef struct
 {
-	size_t index;
-	struct ClusterChainNode* next;
-	struct ClusterChain* chain;
-} ClusterChainNode;
+	size_t start;
+	size_t length;
+} ClusterExtent;
 
-/* Specialized singly-linked list for storing chains of FAT12 cluster indices */
+/* Specialized growable array of extents for storing chains of FAT12 cluster indices
+ * Extents are allocated from arena if set, and from the heap otherwise */
 typedef struct ClusterChain
 {
-	ClusterChainNode* head;
-	ClusterChainNode* tail;
+	ClusterExtent* extents;
+	size_t extentsLength;
+	size_t extentsCapacity;
 	size_t length;
 	DirectoryEntry* directoryEntry;
+	Arena* arena;
 } ClusterChain;
 
-/** @brief	Allocate and initialize an empty ClusterChain linked list on the heap
+/* Iterator over the cluster indices of a ClusterChain, in chain order */
+typedef struct
+{
+	ClusterChain* chain;
+	size_t extent;
+	size_t offset;
+	size_t index;
+} ClusterChainIterator;
+
+/** @brief	Allocate and initialize an empty ClusterChain on the heap
  *
- *			This function will dynamically allocate a ClusterChain struct. Caller must free the HashTable
+ *			This function will dynamically allocate a ClusterChain struct. Caller must free the ClusterChain
  *			struct by calling ClusterChain_Free(ClusterChain*). Simply calling free() will cause memory leaks!
  *
  *  @return pointer to dynamically allocated ClusterChain struct
@@ -46,19 +57,30 @@ ClusterChain* ClusterChain_Make();
  *  @param 	chain */
 void ClusterChain_Free(ClusterChain* chain);
 
-/** @brief	Free the nodes appended onto a ClusterChain linked list struct
+/** @brief	Free the extents appended onto a ClusterChain struct
  *
  *			Call this function if you manually initialized ClusterChain on the stack or heap
- *			and any indices were appended onto the linked list using ClusterChain_Append()
+ *			and any indices were appended onto the chain using ClusterChain_Append(). 
+ *			Extents allocated from an arena are released along with the arena instead. 
  *
  *  @param 	chain */
-void ClusterChain_FreeNodes(ClusterChain* chain);
+void ClusterChain_FreeExtents(ClusterChain* chain);
+
+/** @brief	Make room for at least extentsCapacity extents in a ClusterChain
+ *
+ *			Appending never allocates while the chain has fewer extents than it has room for, so chains
+ *			reserved up front can be filled concurrently, one thread per chain. 
+ *
+ *  @param 	chain
+ *  @param 	extentsCapacity	number of extents to make room for */
+void ClusterChain_Reserve(ClusterChain* chain, size_t extentsCapacity);
 
-/** @brief	Append a new index onto a ClusterChain linked list
+/** @brief	Append a new index onto a ClusterChain
  *
- *			This function will append an index onto the tail of the linked list,
- *			allocating memory for the new node on the heap. Caller must call 
- *			ClusterChain_FreeNodes() or ClusterChain_Free() afterwards. 
+ *			This function will append an index onto the end of the chain. If the index directly
+ *			follows the last index in the chain, the last extent is extended, otherwise a new extent is
+ *			added, growing the extent array on the heap (or arena) as needed. Caller must call 
+ *			ClusterChain_FreeExtents() or ClusterChain_Free() afterwards. 
  *
  *  @param 	chain
  *  @param 	index 	value to append */
@@ -66,21 +88,63 @@ void ClusterChain_Append(ClusterChain* chain, size_t index);
 
 /** @brief	Truncate the ClusterChain to be the specified length
  *
- *			This function will remove any nodes past the desired length and
- *			free the memory allocated for the nodes. 
+ *			This function will remove any indices past the desired length, dropping
+ *			and shortening extents as needed. 
  *
  *  @param 	chain
  *  @param 	newLength */
 void ClusterChain_Truncate(ClusterChain* chain, size_t newLength);
 
-/** @brief	Check if ClusterChain length is consistent with DirectoryEntry assuming specified sector size 
+/** @brief	Check if ClusterChain length is consistent with DirectoryEntry assuming specified cluster size 
  *
  *			This function will check if the length of a ClusterChain is consistent with the 
- *			fileSize of the directoryEntry field, assuming the specified sector size
+ *			fileSize of the directoryEntry field, assuming the specified cluster size
  *
- *			This function will return true if the directoryEntry field is NULL
+ *			This function will return true if the directoryEntry field is NULL, or if it is a
+ *			subdirectory (subdirectories always have a fileSize of 0)
  *
  *  @param 	chain
- *  @param 	sectorSize	size of sector in bytes
+ *  @param 	clusterSize	size of cluster in bytes
  *  @return true if length matches DirectoryEntry size, false otherwise */
-bool ClusterChain_SizeMatchesDirectoryEntry(ClusterChain* chain, size_t sectorSize);
\ No newline at end of file
+bool ClusterChain_SizeMatchesDirectoryEntry(ClusterChain* chain, size_t clusterSize);
+
+/** @brief	Get the first index in a non-empty ClusterChain
+ *
+ *  @param 	chain
+ *  @return first cluster index */
+size_t ClusterChain_Head(ClusterChain* chain);
+
+/** @brief	Get the last index in a non-empty ClusterChain
+ *
+ *  @param 	chain
+ *  @return last cluster index */
+size_t ClusterChain_Tail(ClusterChain* chain);
+
+/** @brief	Get the index at the specified position of a ClusterChain
+ *
+ *			This function walks the extents, so it takes time proportional to the number of extents.  
+ *
+ *  @param 	chain
+ *  @param 	position	position in chain, must be less than chain length
+ *  @return cluster index at position */
+size_t ClusterChain_IndexAt(ClusterChain* chain, size_t position);
+
+/** @brief	Get an iterator positioned at the first index of a ClusterChain
+ *
+ *			Iterate over all indices with:
+ *			for(ClusterChainIterator it = ClusterChain_Begin(chain) ; ClusterChainIterator_IsValid(&it) ; ClusterChainIterator_Next(&it))
+ *
+ *  @param 	chain
+ *  @return iterator, invalid if chain is empty */
+ClusterChainIterator ClusterChain_Begin(ClusterChain* chain);
+
+/** @brief	Check if an iterator points to an index
+ *
+ *  @param 	iterator
+ *  @return true if iterator->index is valid, false if iteration is past the end of the chain */
+bool ClusterChainIterator_IsValid(ClusterChainIterator* iterator);
+
+/** @brief	Advance an iterator to the next index in the chain
+ *
+ *  @param 	iterator */
+void ClusterChainIterator_Next(ClusterChainIterator* iterator);
@@ -4,19 +4,21 @@
 TEST ClusterChainMake_ReturnsZeroedOutStruct()
 {
 	ClusterChain* chain = ClusterChain_Make();
-	ASSERT_EQ(chain->head, NULL);
-	ASSERT_EQ(chain->tail, NULL);
+	ASSERT_EQ(chain->extents, NULL);
+	ASSERT_EQ(chain->extentsLength, 0);
 	ASSERT_EQ(chain->length, 0);
 	ASSERT_EQ(chain->directoryEntry, NULL);
 	ClusterChain_Free(chain);
 	PASS();
 }
 
-TEST ClusterChainAppend_SetsChainPropertyOfNewNode()
+TEST ClusterChainAppend_SetsChainPropertyOfIterator()
 {
 	ClusterChain* chain = ClusterChain_Make();
 	ClusterChain_Append(chain, 5);
-	ASSERT_EQ(chain->head->chain, chain);
+	ClusterChainIterator iterator = ClusterChain_Begin(chain);
+	ASSERT_EQ(iterator.chain, chain);
+	ASSERT_EQ(iterator.index, 5);
 	ClusterChain_Free(chain);
 	PASS();
 }
@@ -35,8 +37,8 @@ TEST ClusterChainAppend_FirstElement_SetsHeadAndTail()
 {
 	ClusterChain* chain = ClusterChain_Make();
 	ClusterChain_Append(chain, 5);
-	ASSERT_EQ(chain->head->index, 5);
-	ASSERT_EQ(chain->tail->index, 5);
+	ASSERT_EQ(ClusterChain_Head(chain), 5);
+	ASSERT_EQ(ClusterChain_Tail(chain), 5);
 	ClusterChain_Free(chain);
 	PASS();
 }
@@ -48,27 +50,85 @@ TEST ClusterChainAppend_UpdatesAllReferences()
 	ClusterChain_Append(chain, 2);
 	ClusterChain_Append(chain, 3);
 	ASSERT_EQ(chain->length, 3);
-	ASSERT_EQ(chain->head->index, 1);
-	ASSERT_EQ(chain->head->next->index, 2);
-	ASSERT_EQ(chain->head->next->next->index, 3);
-	ASSERT_EQ(chain->tail->index, 3);
+	ASSERT_EQ(ClusterChain_Head(chain), 1);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 1), 2);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 2), 3);
+	ASSERT_EQ(ClusterChain_Tail(chain), 3);
 	ClusterChain_Free(chain);
 	PASS();
 }
 
-TEST ClusterChainFreeNodes_UpdatesLengthAndHeadAndTail()
+TEST ClusterChainAppend_MergesAdjacentIndicesIntoExtents()
+{
+	ClusterChain* chain = ClusterChain_Make();
+	ClusterChain_Append(chain, 4);
+	ClusterChain_Append(chain, 5);
+	ClusterChain_Append(chain, 6);
+	ClusterChain_Append(chain, 2);
+	ClusterChain_Append(chain, 3);
+	ClusterChain_Append(chain, 9);
+	ASSERT_EQ(chain->length, 6);
+	ASSERT_EQ(chain->extentsLength, 3);
+	ASSERT_EQ(chain->extents[0].start, 4); ASSERT_EQ(chain->extents[0].length, 3);
+	ASSERT_EQ(chain->extents[1].start, 2); ASSERT_EQ(chain->extents[1].length, 2);
+	ASSERT_EQ(chain->extents[2].start, 9); ASSERT_EQ(chain->extents[2].length, 1);
+
+	size_t expected[] = { 4, 5, 6, 2, 3, 9 };
+	size_t position = 0;
+	for(ClusterChainIterator it = ClusterChain_Begin(chain) ; ClusterChainIterator_IsValid(&it) ; ClusterChainIterator_Next(&it))
+		ASSERT_EQ(it.index, expected[position++]);
+	ASSERT_EQ(position, 6);
+	ClusterChain_Free(chain);
+	PASS();
+}
+
+TEST ClusterChainAppend_AllocatesExtentsFromArena()
+{
+	ClusterChain chain = { 0 };
+	chain.arena = Arena_Make(1024);
+	for(size_t index = 0 ; index < 20 ; ++index)
+		ClusterChain_Append(&chain, index * 2);
+	ASSERT_EQ(chain.length, 20);
+	ASSERT_EQ(chain.extentsLength, 20);
+	ASSERT_EQ(ClusterChain_Tail(&chain), 38);
+	ASSERT(chain.arena->bytesAllocated >= 20 * sizeof(ClusterExtent));
+	ClusterChain_FreeExtents(&chain);
+	Arena_Free(chain.arena);
+	PASS();
+}
+
+TEST ClusterChainReserve_AppendWithinCapacityKeepsExtents()
+{
+	ClusterChain* chain = ClusterChain_Make();
+	ClusterChain_Reserve(chain, 3);
+	ClusterExtent* extents = chain->extents;
+	ASSERT_EQ(chain->extentsCapacity, 3);
+
+	ClusterChain_Append(chain, 5);
+	ClusterChain_Append(chain, 9);
+	ClusterChain_Append(chain, 2);
+	ASSERT_EQ(chain->extents, extents);
+	ASSERT_EQ(chain->extentsLength, 3);
+
+	ClusterChain_Reserve(chain, 2);
+	ASSERT_EQ(chain->extentsCapacity, 3);
+	ClusterChain_Free(chain);
+	PASS();
+}
+
+TEST ClusterChainFreeExtents_UpdatesLengthAndExtents()
 {
 	ClusterChain* chain = ClusterChain_Make();
 	ClusterChain_Append(chain, 1);
 	ClusterChain_Append(chain, 2);
 	ClusterChain_Append(chain, 3);
 	ASSERT_EQ(chain->length, 3);
-	ASSERT_EQ(chain->head->index, 1);
-	ASSERT_EQ(chain->tail->index, 3);
-	ClusterChain_FreeNodes(chain);
+	ASSERT_EQ(ClusterChain_Head(chain), 1);
+	ASSERT_EQ(ClusterChain_Tail(chain), 3);
+	ClusterChain_FreeExtents(chain);
 	ASSERT_EQ(chain->length, 0);
-	ASSERT_EQ(chain->head, NULL);
-	ASSERT_EQ(chain->tail, NULL);
+	ASSERT_EQ(chain->extents, NULL);
+	ASSERT_EQ(chain->extentsLength, 0);
 	ClusterChain_Free(chain);
 	PASS();
 }
@@ -85,7 +145,7 @@ TEST ClusterChain_SizeMatchesDirectoryEntry_Entry0BytesLength1_True()
 {
 	ClusterChain* chain = ClusterChain_Make();
 	ClusterChain_Append(chain, 42);
-	DirectoryEntry entry;
+	DirectoryEntry entry = { 0 };
 	entry.fileSize = 0;
 	chain->directoryEntry = &entry;
 	ASSERT_EQ(true, ClusterChain_SizeMatchesDirectoryEntry(chain, 512));
@@ -97,7 +157,7 @@ TEST ClusterChain_SizeMatchesDirectoryEntry_Entry512BytesLength1_True()
 {
 	ClusterChain* chain = ClusterChain_Make();
 	ClusterChain_Append(chain, 42);
-	DirectoryEntry entry;
+	DirectoryEntry entry = { 0 };
 	entry.fileSize = 512;
 	chain->directoryEntry = &entry;
 	ASSERT_EQ(true, ClusterChain_SizeMatchesDirectoryEntry(chain, 512));
@@ -109,7 +169,7 @@ TEST ClusterChain_SizeMatchesDirectoryEntry_Entry513BytesLength1_False()
 {
 	ClusterChain* chain = ClusterChain_Make();
 	ClusterChain_Append(chain, 42);
-	DirectoryEntry entry;
+	DirectoryEntry entry = { 0 };
 	entry.fileSize = 513;
 	chain->directoryEntry = &entry;
 	ASSERT_EQ(false, ClusterChain_SizeMatchesDirectoryEntry(chain, 512));
@@ -122,7 +182,7 @@ TEST ClusterChain_SizeMatchesDirectoryEntry_Entry517BytesLength2_True()
 	ClusterChain* chain = ClusterChain_Make();
 	ClusterChain_Append(chain, 42);
 	ClusterChain_Append(chain, 42);
-	DirectoryEntry entry;
+	DirectoryEntry entry = { 0 };
 	entry.fileSize = 517;
 	chain->directoryEntry = &entry;
 	ASSERT_EQ(true, ClusterChain_SizeMatchesDirectoryEntry(chain, 512));
@@ -130,6 +190,20 @@ TEST ClusterChain_SizeMatchesDirectoryEntry_Entry517BytesLength2_True()
 	PASS();
 }
 
+TEST ClusterChain_SizeMatchesDirectoryEntry_SubdirectoryLength3_True()
+{
+	ClusterChain* chain = ClusterChain_Make();
+	ClusterChain_Append(chain, 42);
+	ClusterChain_Append(chain, 43);
+	ClusterChain_Append(chain, 44);
+	DirectoryEntry entry = { 0 };
+	entry.attributes = 0x10;
+	chain->directoryEntry = &entry;
+	ASSERT_EQ(true, ClusterChain_SizeMatchesDirectoryEntry(chain, 512));
+	ClusterChain_Free(chain);
+	PASS();
+}
+
 TEST ClusterChain_Truncate_EqualToCurrentLength_Noop()
 {
 	ClusterChain* chain = ClusterChain_Make();
@@ -138,10 +212,10 @@ TEST ClusterChain_Truncate_EqualToCurrentLength_Noop()
 	ClusterChain_Append(chain, 3);
 	ClusterChain_Truncate(chain, 3);
 	ASSERT_EQ(chain->length, 3);
-	ASSERT_EQ(chain->head->index, 1);
-	ASSERT_EQ(chain->head->next->index, 2);
-	ASSERT_EQ(chain->head->next->next->index, 3);
-	ASSERT_EQ(chain->tail->index, 3);
+	ASSERT_EQ(ClusterChain_Head(chain), 1);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 1), 2);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 2), 3);
+	ASSERT_EQ(ClusterChain_Tail(chain), 3);
 	ClusterChain_Free(chain);
 	PASS();
 }
@@ -154,10 +228,10 @@ TEST ClusterChain_Truncate_GreaterThanCurrentLength_Noop()
 	ClusterChain_Append(chain, 3);
 	ClusterChain_Truncate(chain, 5);
 	ASSERT_EQ(chain->length, 3);
-	ASSERT_EQ(chain->head->index, 1);
-	ASSERT_EQ(chain->head->next->index, 2);
-	ASSERT_EQ(chain->head->next->next->index, 3);
-	ASSERT_EQ(chain->tail->index, 3);
+	ASSERT_EQ(ClusterChain_Head(chain), 1);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 1), 2);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 2), 3);
+	ASSERT_EQ(ClusterChain_Tail(chain), 3);
 	ClusterChain_Free(chain);
 	PASS();
 }
@@ -172,9 +246,29 @@ TEST ClusterChain_Truncate_LessThanCurrentLength_Success()
 	ClusterChain_Append(chain, 5);
 	ClusterChain_Truncate(chain, 2);
 	ASSERT_EQ(chain->length, 2);
-	ASSERT_EQ(chain->head->index, 1);
-	ASSERT_EQ(chain->head->next->index, 2);
-	ASSERT_EQ(chain->head->next->next, NULL);
+	ClusterChainIterator iterator = ClusterChain_Begin(chain);
+	ASSERT_EQ(iterator.index, 1);
+	ClusterChainIterator_Next(&iterator);
+	ASSERT_EQ(iterator.index, 2);
+	ClusterChainIterator_Next(&iterator);
+	ASSERT_EQ(ClusterChainIterator_IsValid(&iterator), false);
+	ClusterChain_Free(chain);
+	PASS();
+}
+
+TEST ClusterChain_Truncate_SplitsExtent()
+{
+	ClusterChain* chain = ClusterChain_Make();
+	ClusterChain_Append(chain, 7);
+	ClusterChain_Append(chain, 2);
+	ClusterChain_Append(chain, 3);
+	ClusterChain_Append(chain, 4);
+	ClusterChain_Append(chain, 5);
+	ClusterChain_Truncate(chain, 3);
+	ASSERT_EQ(chain->length, 3);
+	ASSERT_EQ(chain->extentsLength, 2);
+	ASSERT_EQ(ClusterChain_Head(chain), 7);
+	ASSERT_EQ(ClusterChain_Tail(chain), 3);
 	ClusterChain_Free(chain);
 	PASS();
 }
@@ -184,19 +278,25 @@ SUITE(ClusterChainTest)
 	RUN_TEST(ClusterChainMake_ReturnsZeroedOutStruct);
 
 	RUN_TEST(ClusterChainAppend_IncrementsLength);
-	RUN_TEST(ClusterChainAppend_SetsChainPropertyOfNewNode);
+	RUN_TEST(ClusterChainAppend_SetsChainPropertyOfIterator);
 	RUN_TEST(ClusterChainAppend_FirstElement_SetsHeadAndTail);
 	RUN_TEST(ClusterChainAppend_UpdatesAllReferences);
 
-	RUN_TEST(ClusterChainFreeNodes_UpdatesLengthAndHeadAndTail);
+	RUN_TEST(ClusterChainAppend_MergesAdjacentIndicesIntoExtents);
+	RUN_TEST(ClusterChainAppend_AllocatesExtentsFromArena);
+
+	RUN_TEST(ClusterChainReserve_AppendWithinCapacityKeepsExtents);
+	RUN_TEST(ClusterChainFreeExtents_UpdatesLengthAndExtents);
 
 	RUN_TEST(ClusterChain_SizeMatchesDirectoryEntry_NoEntryTrue);
 	RUN_TEST(ClusterChain_SizeMatchesDirectoryEntry_Entry0BytesLength1_True);
 	RUN_TEST(ClusterChain_SizeMatchesDirectoryEntry_Entry512BytesLength1_True);
 	RUN_TEST(ClusterChain_SizeMatchesDirectoryEntry_Entry513BytesLength1_False);
 	RUN_TEST(ClusterChain_SizeMatchesDirectoryEntry_Entry517BytesLength2_True);
+	RUN_TEST(ClusterChain_SizeMatchesDirectoryEntry_SubdirectoryLength3_True);
 
 	RUN_TEST(ClusterChain_Truncate_EqualToCurrentLength_Noop);
 	RUN_TEST(ClusterChain_Truncate_GreaterThanCurrentLength_Noop);
 	RUN_TEST(ClusterChain_Truncate_LessThanCurrentLength_Success);
+	RUN_TEST(ClusterChain_Truncate_SplitsExtent);
 }
\ No newline at end of file
@@ -27,18 +27,25 @@ bool DirectoryEntry_IsSubdirectory(DirectoryEntry* directoryEntry)
 	return (directoryEntry->attributes & Subdirectory) > 0;
 }
 
-void DirectoryEntry_Print(DirectoryEntry* directoryEntry)
+bool DirectoryEntry_HasName(DirectoryEntry* directoryEntry, const char* name)
+{
+	assert(directoryEntry != NULL);
+	assert(name != NULL);
+	return memcmp(directoryEntry->name, name, sizeof(directoryEntry->name)) == 0;
+}
+
+void DirectoryEntry_Print(DirectoryEntry* directoryEntry, FILE* output)
 {
 	assert(directoryEntry != NULL);
 	bool isDirectory = DirectoryEntry_IsSubdirectory(directoryEntry);
-	printf(isDirectory ? "Directory" : "File");
-	if(directoryEntry->filename && strlen(directoryEntry->filename) > 0)
+	fprintf(output, isDirectory ? "Directory" : "File");
+	if(strlen(directoryEntry->filename) > 0)
 	{
-		printf(" named %s", directoryEntry->filename);
-		if(directoryEntry->extension && strlen(directoryEntry->extension) > 0)
-			printf(".%s", directoryEntry->extension);
+		fprintf(output, " named %s", directoryEntry->filename);
+		if(strlen(directoryEntry->extension) > 0)
+			fprintf(output, ".%s", directoryEntry->extension);
 	}
 	if(!isDirectory)
-		printf(" of size %zd bytes", directoryEntry->fileSize);
-	printf(" starting at cluster %zd\n", directoryEntry->startCluster);
+		fprintf(output, " of size %zd bytes", directoryEntry->fileSize);
+	fprintf(output, " starting at cluster %zd\n", directoryEntry->startCluster);
 }
\ No newline at end of file
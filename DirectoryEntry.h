@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -16,8 +17,9 @@
 typedef struct DirectoryEntry
 {
 	struct DirectoryEntry* parent;
-	char* filename;
-	char* extension;
+	char filename[9];
+	char extension[4];
+	uint8_t name[11];		// packed 8.3 name, exactly as stored on disk
 	uint8_t attributes;
 	size_t fileSize;
 	size_t startCluster;
@@ -37,8 +39,20 @@ bool DirectoryEntry_IsVolumeLabel(DirectoryEntry* directoryEntry);
  */
 bool DirectoryEntry_IsSubdirectory(DirectoryEntry* directoryEntry);
 
-/** @brief	(For debug purposes) Print DirectoryEntry contents to stdout 
+/** @brief	Check if a DirectoryEntry has the specified packed 8.3 name
+ *
+ *	The name is compared as the 11-byte key stored on disk, i.e. the filename and
+ *	the extension each padded with spaces, such as "FOUND1  DAT". 
+ *
+ *	@param	directoryEntry
+ *	@param	name	11-byte packed name
+ *  @return true if names match, false otherwise
+ */
+bool DirectoryEntry_HasName(DirectoryEntry* directoryEntry, const char* name);
+
+/** @brief	(For debug purposes) Print DirectoryEntry contents to a stream 
  *
 *	@param	directoryEntry
+ *	@param	output	stream to print to, such as stdout
  */
-void DirectoryEntry_Print(DirectoryEntry* directoryEntry);
\ No newline at end of file
+void DirectoryEntry_Print(DirectoryEntry* directoryEntry, FILE* output);
\ No newline at end of file
@@ -1,31 +1,61 @@
+#define _DEFAULT_SOURCE
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <pthread.h>
 #include <assert.h>
-#include <math.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
-#include "FATImage.h"
+#include <time.h>
+#include "FATImageInternal.h"
 #include "Helpers.h"
 
 #define NONE 0
 #define INFO 1
 #define DETAIL 2
 #define DEBUG 3
-extern int log_level;
-#define LOG(level, ...) if (level <= log_level) printf(__VA_ARGS__);
 
-#define LOG_LEVEL NONE
+/* Highest level of log messages compiled in (make LOG_LEVEL=0 removes all of them), levels up to it are chosen at runtime */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL DEBUG
+#endif
+#define LOG_ENABLED(level) ((level) <= LOG_LEVEL && (level) <= disk->logLevel)
+#define LOG(level, ...) if (LOG_ENABLED(level)) fprintf(disk->output, __VA_ARGS__);
+
+/* Phase timers and counters, each a single branch while stats are disabled */
+#define STATS_START() uint64_t statsStart = disk->stats.enabled ? FATImage_Clock() : 0
+#define STATS_STOP(phase) if (disk->stats.enabled) disk->stats.phaseNanoseconds[phase] += FATImage_Clock() - statsStart
+#define STATS_ADD(counter, amount) if (disk->stats.enabled) disk->stats.counter += (amount)
+
+/* Entries decoded at once by lazy lookups, even so FAT12 blocks never start inside a byte */
+#define CLUSTER_BLOCK 4096
+#define IMAGE_BLOCK 4096
+
+static uint64_t FATImage_Clock()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
 
 FATImage* FATImage_Make()
 {
 	FATImage* new = calloc(1, sizeof(FATImage));
 	assert(new != NULL);
 
+	new->arena = Arena_Make(64 * 1024);
+	new->workerCount = 1;
+	new->output = stdout;
+	new->logLevel = NONE;
+	new->report = Report_Make(stdout, ReportText);
+
+	// classification works without an image, replaced once the boot sector has been read
+	FileAllocationTable_Initialize(&(new->table), FAT12, NULL, 0);
+
 	new->clusterChains = calloc(16, sizeof(ClusterChain));
 	assert(new->clusterChains != NULL);
 	new->clusterChainsCapacity = 16;
@@ -39,31 +69,70 @@ FATImage* FATImage_Make()
 	return new;
 }
 
+/* adds an error record naming what failed and the system error, and writes it out straight away */
+static void FATImage_ReportSystemError(FATImage* disk, const char* what, int error)
+{
+	Report_AddError(disk->report, what, error);
+	Report_Flush(disk->report);
+}
+
+/* adds an error record for a boot sector the image cannot be checked with */
+static bool FATImage_ReportInvalid(FATImage* disk, const char* problem)
+{
+	char message[256];
+	snprintf(message, sizeof(message), "invalid boot sector: %s", problem);
+	Report_AddNamed(disk->report, ReportError, message, 0, 0);
+	Report_Flush(disk->report);
+	return false;
+}
+
 FATImage* FATImage_Initialize(char* imageFile)
+{
+	return FATImage_InitializeWithMode(imageFile, FATImageShared, FATImageMapped);
+}
+
+static char* FATImage_JournalPath(char* imageFile)
+{
+	char* journalPath = malloc(strlen(imageFile) + sizeof(".journal"));
+	assert(journalPath != NULL);
+	sprintf(journalPath, "%s.journal", imageFile);
+	return journalPath;
+}
+
+FATImage* FATImage_InitializeWithMode(char* imageFile, FATImageMode mode, FATImageBackend backend)
 {
 	int currentError;
-	int fileDescriptor = open(imageFile, O_RDWR);
+	int fileDescriptor = open(imageFile, mode == FATImageReadOnly ? O_RDONLY : O_RDWR);
 	if(fileDescriptor == -1)
-	{
-		currentError = errno;
-		printf("dos_scandisk: %s\n", strerror(currentError));
 		return NULL;
-	}
 
 	struct stat fileInfo;
 	if(fstat(fileDescriptor, &fileInfo) == -1)
 	{
 		currentError = errno;
-		printf("dos_scandisk: error reading image file: %s\n", strerror(currentError));
+		close(fileDescriptor);
+		errno = currentError;
 		return NULL;
 	}
 
 	size_t fileSize = fileInfo.st_size;
-	uint8_t* image = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+	// a private mapping keeps repairs out of the page cache until they are committed
+	int protection = mode == FATImageReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+	int flags = mode == FATImageShared ? MAP_SHARED : MAP_PRIVATE;
+	uint8_t* image;
+	if(backend == FATImageBuffered)
+	{
+		// address space only, pages are allocated as FATImage_Access() reads blocks into them
+		image = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	}
+	else
+		image = mmap(NULL, fileSize, protection, flags, fileDescriptor, 0);
 	if(image == MAP_FAILED)
 	{
+		// an empty image cannot be mapped and fails with EINVAL
 		currentError = errno;
-		printf("dos_scandisk: error mapping image file: %s\n", strerror(currentError));
+		close(fileDescriptor);
+		errno = currentError;
 		return NULL;
 	}
 
@@ -71,7 +140,15 @@ FATImage* FATImage_Initialize(char* imageFile)
 	new->imageSize = fileSize;
 	new->image = image;
 	new->imageFileDescriptor = fileDescriptor;
-	LOG(DETAIL, "successfully mapped %zd bytes to fd %d\n", new->imageSize, new->imageFileDescriptor);
+	new->mode = mode;
+	new->imagePath = malloc(strlen(imageFile) + 1);
+	assert(new->imagePath != NULL);
+	strcpy(new->imagePath, imageFile);
+	if(mode == FATImageJournaled)
+		new->journalPath = FATImage_JournalPath(imageFile);
+	new->backend = backend;
+	if(backend == FATImageBuffered)
+		Bitset_Initialize(&(new->loadedImageBlocks), new->arena, (fileSize + IMAGE_BLOCK - 1) / IMAGE_BLOCK);
 	return new;
 }
 
@@ -80,46 +157,302 @@ void FATImage_Free(FATImage* toFree)
 	assert(toFree != NULL);
 	munmap(toFree->image, toFree->imageSize);	
 	close(toFree->imageFileDescriptor);
+	Report_Free(toFree->report);
+	free(toFree->imagePath);
+	free(toFree->journalPath);
 
-	for(size_t index = 0 ; index < toFree->clusterChainsLength ; ++index)
-		ClusterChain_FreeNodes(toFree->clusterChains + index);
+	// cluster columns and chain extents all live in the arena
+	Arena_Free(toFree->arena);
 	free(toFree->clusterChains);
+	free(toFree->directoryEntries);
+	free(toFree);
+}
+
+uint8_t* FATImage_Access(FATImage* disk, size_t offset, size_t length)
+{
+	assert(disk != NULL);
+	assert(offset + length <= disk->imageSize);
+	if(disk->backend != FATImageBuffered)
+		return disk->image + offset;
 
-	for(size_t index = 0 ; index < toFree->directoryEntriesLength ; ++index)
+	size_t end = (offset + length + IMAGE_BLOCK - 1) / IMAGE_BLOCK;
+	for(size_t block = offset / IMAGE_BLOCK ; block < end ; )
 	{
-		free(toFree->directoryEntries[index].filename);
-		free(toFree->directoryEntries[index].extension);
+		if(Bitset_Test(&(disk->loadedImageBlocks), block))
+		{
+			++block;
+			continue;
+		}
+
+		// one read for each run of blocks not read yet
+		size_t runEnd = block + 1;
+		while(runEnd < end && !Bitset_Test(&(disk->loadedImageBlocks), runEnd))
+			++runEnd;
+		size_t start = block * IMAGE_BLOCK;
+		size_t stop = runEnd * IMAGE_BLOCK < disk->imageSize ? runEnd * IMAGE_BLOCK : disk->imageSize;
+		for(size_t position = start ; position < stop ; )
+		{
+			ssize_t count = pread(disk->imageFileDescriptor, disk->image + position, stop - position, position);
+			if(count == -1 && errno == EINTR)
+				continue;
+			if(count <= 0)
+			{
+				// the blocks of this run stay unread, so a later access tries them again
+				FATImage_ReportSystemError(disk, "error reading image file", count == 0 ? EIO : errno);
+				return NULL;
+			}
+			position += count;
+		}
+
+		LOG(DETAIL, "read bytes %zd-%zd of the image\n", start, stop - 1);
+		Bitset_SetRange(&(disk->loadedImageBlocks), block, runEnd - block);
+		disk->bytesLoaded += stop - start;
+		block = runEnd;
 	}
-	free(toFree->directoryEntries);
-	
-	free(toFree->clusters);
-	free(toFree);
+	return disk->image + offset;
 }
 
 long FATImage_ReadLittleEndian(FATImage* disk, size_t sector, size_t offset, size_t length)
 {
 	assert(disk != NULL);
-	return NumberFrom8BitLittleEndianSequence(&(disk->image[sector * disk->information.sectorSize + offset]), length);
+	return NumberFrom8BitLittleEndianSequence(FATImage_Access(disk, sector * disk->information.sectorSize + offset, length), length);
+}
+
+void FATImage_MarkDirty(FATImage* disk, uint8_t* start, size_t length)
+{
+	assert(disk != NULL);
+	assert(start >= disk->image && start + length <= disk->image + disk->imageSize);
+
+	size_t offset = start - disk->image;
+	if(disk->dirtyRangesLength > 0)
+	{
+		// writes mostly walk forward through the same few bytes, extend the last range when they touch it
+		FATDirtyRange* last = disk->dirtyRanges + (disk->dirtyRangesLength - 1);
+		if(offset >= last->offset && offset <= last->offset + last->length)
+		{
+			if(offset + length > last->offset + last->length)
+				last->length = offset + length - last->offset;
+			return;
+		}
+	}
+
+	if(disk->dirtyRangesLength >= disk->dirtyRangesCapacity)
+	{
+		size_t capacity = disk->dirtyRangesCapacity > 0 ? 2 * disk->dirtyRangesCapacity : 16;
+		disk->dirtyRanges = Arena_Reallocate(disk->arena, disk->dirtyRanges, disk->dirtyRangesCapacity * sizeof(FATDirtyRange), capacity * sizeof(FATDirtyRange));
+		disk->dirtyRangesCapacity = capacity;
+	}
+
+	disk->dirtyRanges[disk->dirtyRangesLength].offset = offset;
+	disk->dirtyRanges[disk->dirtyRangesLength].length = length;
+	disk->dirtyRangesLength += 1;
+}
+
+static int FATImage_CompareDirtyRanges(const void* a, const void* b)
+{
+	size_t offsetA = ((const FATDirtyRange*)a)->offset;
+	size_t offsetB = ((const FATDirtyRange*)b)->offset;
+	return offsetA < offsetB ? -1 : offsetA > offsetB;
 }
 
-void FATImage_UpdateDiskInformation(FATImage* disk)
+/* rounds dirty ranges out to whole pages, sorts and merges them in place, returns the number of page ranges */
+size_t FATImage_CoalesceDirtyPages(FATImage* disk, size_t pageSize)
 {
 	assert(disk != NULL);
+
+	FATDirtyRange* ranges = disk->dirtyRanges;
+	for(size_t index = 0 ; index < disk->dirtyRangesLength ; ++index)
+	{
+		size_t start = ranges[index].offset / pageSize * pageSize;
+		size_t end = (ranges[index].offset + ranges[index].length + pageSize - 1) / pageSize * pageSize;
+		ranges[index].offset = start;
+		ranges[index].length = end - start;
+	}
+	if(disk->dirtyRangesLength > 1)
+		qsort(ranges, disk->dirtyRangesLength, sizeof(FATDirtyRange), FATImage_CompareDirtyRanges);
+
+	size_t merged = 0;
+	for(size_t index = 0 ; index < disk->dirtyRangesLength ; ++index)
+	{
+		if(merged > 0 && ranges[index].offset <= ranges[merged - 1].offset + ranges[merged - 1].length)
+		{
+			size_t end = ranges[index].offset + ranges[index].length;
+			if(end > ranges[merged - 1].offset + ranges[merged - 1].length)
+				ranges[merged - 1].length = end - ranges[merged - 1].offset;
+		}
+		else
+			ranges[merged++] = ranges[index];
+	}
+	disk->dirtyRangesLength = merged;
+	return merged;
+}
+
+/* status of a cluster holding value in the file allocation table */
+static inline ClusterStatus FATImage_ClassifyValue(FileAllocationTable* table, uint32_t value)
+{
+	if(value == 0x00)
+		return Unused;
+	if(value >= table->reservedMin && value < table->bad)
+		return Reserved;
+	if(value == table->bad)
+		return Bad;
+	if(value >= table->endOfChainMin && value <= table->endOfChain)
+		return FileLast;
+	return File;
+}
+
+void FATImage_SetClusterStatus(FATImage* disk, size_t cluster, ClusterStatus status)
+{
+	assert(disk != NULL);
+	assert(cluster < disk->clustersLength);
+
+	disk->clusterStatusCounts[disk->clusterStatuses[cluster]] -= 1;
+	disk->clusterStatusCounts[status] += 1;
+	disk->clusterStatuses[cluster] = status;
+}
+
+/* writes a table entry and records the bytes it spans (two for FAT12 and FAT16, four for FAT32), keeping the value
+ * and status columns in step when the entry has been decoded */
+void FATImage_WriteTableEntry(FATImage* disk, size_t cluster, uint32_t value)
+{
+	FileAllocationTable_Write(&(disk->table), cluster, value);
+	size_t offset = cluster * disk->table.type / 8;
+	FATImage_MarkDirty(disk, disk->table.base + offset, disk->table.type == FAT32 ? 4 : 2);
+
+	if(disk->clusterValues == NULL || cluster >= disk->clustersLength || !Bitset_Test(&(disk->decodedClusterBlocks), cluster / CLUSTER_BLOCK))
+		return;
+	disk->clusterValues[cluster] = FileAllocationTable_Read(&(disk->table), cluster);
+	if(disk->clusterStatuses != NULL && cluster >= 2)
+		FATImage_SetClusterStatus(disk, cluster, FATImage_ClassifyValue(&(disk->table), disk->clusterValues[cluster]));
+}
+
+/* gives the kernel an access hint for part of the image mapping, widened to whole pages (narrowed for MADV_DONTNEED) */
+void FATImage_AdviseRange(FATImage* disk, size_t offset, size_t length, int advice)
+{
+	// only mappings made by FATImage_InitializeWithMode(), never memory handed in by callers
+	if(disk->imagePath == NULL || length == 0)
+		return;
+
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t end = offset + length < disk->imageSize ? offset + length : disk->imageSize;
+	size_t start = offset / pageSize * pageSize;
+	if(advice == MADV_DONTNEED)
+	{
+		start = (offset + pageSize - 1) / pageSize * pageSize;
+		end = end < disk->imageSize ? end / pageSize * pageSize : end;
+	}
+	if(start >= end)
+		return;
+
+	// a buffered image has no file pages to hint at, but dropping its pages means they must be read again
+	if(disk->backend == FATImageBuffered)
+	{
+		if(advice != MADV_DONTNEED)
+			return;
+		for(size_t block = (start + IMAGE_BLOCK - 1) / IMAGE_BLOCK ; block * IMAGE_BLOCK < end ; ++block)
+			Bitset_Clear(&(disk->loadedImageBlocks), block);
+	}
+
+	madvise(disk->image + start, end - start, advice);
+	LOG(DETAIL, "advised bytes %zd-%zd with %d\n", start, end - 1, advice);
+}
+
+/* reads and checks the boot sector, returning false after reporting the first problem found */
+static bool FATImage_ReadDiskInformation(FATImage* disk)
+{
 	FATDiskInformation* info = &(disk->information);
+	if(disk->imageSize < 512)
+		return FATImage_ReportInvalid(disk, "image is smaller than a boot sector");
+	if(FATImage_Access(disk, 0, 512) == NULL)
+		return false;
 	info->sectorSize = FATImage_ReadLittleEndian(disk, 0, 11, 2);
-	info->sectorCount = FATImage_ReadLittleEndian(disk, 0, 19, 2);
 	info->sectorsPerCluster = FATImage_ReadLittleEndian(disk, 0, 13, 1);
+	if(info->sectorSize != 512 && info->sectorSize != 1024 && info->sectorSize != 2048 && info->sectorSize != 4096)
+		return FATImage_ReportInvalid(disk, "sector size is not 512, 1024, 2048 or 4096 bytes");
+	if(info->sectorsPerCluster == 0 || (info->sectorsPerCluster & (info->sectorsPerCluster - 1)) != 0)
+		return FATImage_ReportInvalid(disk, "sectors per cluster is not a power of two");
+	info->clusterSize = info->sectorSize * info->sectorsPerCluster;
+
+	// 16-bit counts are zero when the value only fits in the 32-bit field
+	info->sectorCount = FATImage_ReadLittleEndian(disk, 0, 19, 2);
+	if(info->sectorCount == 0)
+		info->sectorCount = FATImage_ReadLittleEndian(disk, 0, 32, 4);
 
-	size_t reservedSectors = FATImage_ReadLittleEndian(disk, 0, 14, 2);
-	info->fileAllocationTableStartSector = reservedSectors;
-	info->fileAllocationTableSectorCount = ceil((info->sectorCount - reservedSectors - info->rootDirectorySectorCount) * 3.0 / 2.0 / info->sectorSize);
+	info->fileAllocationTableStartSector = FATImage_ReadLittleEndian(disk, 0, 14, 2);
+	info->fileAllocationTableSectorCount = FATImage_ReadLittleEndian(disk, 0, 22, 2);
+	if(info->fileAllocationTableSectorCount == 0)
+		info->fileAllocationTableSectorCount = FATImage_ReadLittleEndian(disk, 0, 36, 4);
 	info->fileAllocationTableCopies = FATImage_ReadLittleEndian(disk, 0, 16, 1);
+	if(info->fileAllocationTableStartSector == 0)
+		return FATImage_ReportInvalid(disk, "no reserved sectors");
+	if(info->fileAllocationTableCopies == 0 || info->fileAllocationTableSectorCount == 0)
+		return FATImage_ReportInvalid(disk, "no file allocation table");
 	
+	// FAT32 has no fixed root directory region, its root entry count is zero
 	info->rootDirectoryStartSector = info->fileAllocationTableStartSector + info->fileAllocationTableCopies * info->fileAllocationTableSectorCount;
-	info->rootDirectorySectorCount = FATImage_ReadLittleEndian(disk, 0, 17, 2) * 32 / info->sectorSize;
+	info->rootDirectorySectorCount = (FATImage_ReadLittleEndian(disk, 0, 17, 2) * 32 + info->sectorSize - 1) / info->sectorSize;
 
+	// every region must lie inside the image, or reading it would run past the end of the mapping
 	info->dataSectorStartSector = info->rootDirectoryStartSector + info->rootDirectorySectorCount;
+	if(info->sectorCount > disk->imageSize / info->sectorSize)
+		return FATImage_ReportInvalid(disk, "image is shorter than its sector count");
+	if(info->dataSectorStartSector + info->sectorsPerCluster > info->sectorCount)
+		return FATImage_ReportInvalid(disk, "tables and root directory leave no data clusters");
 	info->dataSectorCount = info->sectorCount - info->dataSectorStartSector;
+	info->clusterCount = info->dataSectorCount / info->sectorsPerCluster;
+
+	FATType type = FileAllocationTable_TypeForClusterCount(info->clusterCount);
+	info->rootDirectoryCluster = type == FAT32 ? FATImage_ReadLittleEndian(disk, 0, 44, 4) : 0;
+	if(type == FAT32 && (info->rootDirectoryCluster < 2 || info->rootDirectoryCluster >= info->clusterCount + 2))
+		return FATImage_ReportInvalid(disk, "root directory cluster is outside the data area");
+	size_t tableEntries = info->fileAllocationTableSectorCount * info->sectorSize * 8 / type;
+	if(tableEntries < info->clusterCount + 2)
+		return FATImage_ReportInvalid(disk, "file allocation table is too short for its clusters");
+
+	// boot sector, tables and the FAT12/FAT16 root directory are read in full, the data area only where directories are
+	size_t dataStart = info->dataSectorStartSector * info->sectorSize;
+	if(FATImage_Access(disk, 0, dataStart) == NULL)
+		return false;
+	uint8_t* table = disk->image + info->fileAllocationTableStartSector * info->sectorSize;
+	FileAllocationTable_Initialize(&(disk->table), type, table, tableEntries);
+	LOG(DETAIL, "FAT%d with %zd clusters of %zd bytes\n", type, info->clusterCount, info->clusterSize);
+
+	// the tables and root directory are read front to back, the data area is only visited for directory clusters
+	FATImage_AdviseRange(disk, dataStart, disk->imageSize - dataStart, MADV_RANDOM);
+	FATImage_AdviseRange(disk, 0, dataStart, MADV_SEQUENTIAL);
+	FATImage_AdviseRange(disk, 0, dataStart, MADV_WILLNEED);
+	return true;
+}
+
+bool FATImage_UpdateDiskInformation(FATImage* disk)
+{
+	assert(disk != NULL);
+	STATS_START();
+	bool valid = FATImage_ReadDiskInformation(disk);
+	STATS_STOP(FATPhaseDiskInformation);
+	return valid;
+}
+
+size_t FATImage_ClusterToSector(FATImage* disk, size_t cluster)
+{
+	assert(disk != NULL);
+	assert(cluster >= 2);
+	return disk->information.dataSectorStartSector + (cluster - 2) * disk->information.sectorsPerCluster;
+}
+
+/* grows the cluster chain array to hold at least capacity chains */
+void FATImage_ReserveFileChains(FATImage* disk, size_t capacity)
+{
+	assert(disk != NULL);
+	assert(disk->clusterChains != NULL);
+
+	if(capacity <= disk->clusterChainsCapacity)
+		return;
+
+	disk->clusterChains = realloc(disk->clusterChains, capacity * sizeof(ClusterChain));
+	assert(disk->clusterChains != NULL);
+	memset(disk->clusterChains + disk->clusterChainsCapacity, 0, (capacity - disk->clusterChainsCapacity) * sizeof(ClusterChain));
+	disk->clusterChainsCapacity = capacity;
 }
 
 ClusterChain* FATImage_GetNewFileChain(FATImage* disk)
@@ -128,93 +461,634 @@ ClusterChain* FATImage_GetNewFileChain(FATImage* disk)
 	assert(disk->clusterChains != NULL);
 	
 	if(disk->clusterChainsLength >= disk->clusterChainsCapacity)
+		FATImage_ReserveFileChains(disk, 2 * disk->clusterChainsCapacity);
+
+	disk->clusterChainsLength += 1;
+	ClusterChain* chain = disk->clusterChains + (disk->clusterChainsLength - 1);
+	chain->arena = disk->arena;
+	return chain;
+}
+
+/* value column for the data clusters and the two reserved entries, filled in block by block as lookups need it */
+void FATImage_AllocateClusterValues(FATImage* disk, size_t length)
+{
+	assert(disk != NULL);
+	assert(disk->clusterValues == NULL);
+
+	// arena blocks this large are fresh zero pages, untouched blocks of the column cost no memory
+	disk->clusterValues = Arena_Allocate(disk->arena, length * sizeof(uint32_t));
+	disk->clustersLength = length;
+	Bitset_Initialize(&(disk->decodedClusterBlocks), disk->arena, (length + CLUSTER_BLOCK - 1) / CLUSTER_BLOCK);
+}
+
+void FATImage_AllocateClusters(FATImage* disk, size_t length)
+{
+	assert(disk != NULL);
+	assert(disk->clusterStatuses == NULL);
+
+	if(disk->clusterValues == NULL)
+		FATImage_AllocateClusterValues(disk, length);
+	assert(disk->clustersLength == length);
+
+	disk->clusterStatuses = Arena_Allocate(disk->arena, length * sizeof(uint8_t));
+	disk->clusterChainIds = Arena_Allocate(disk->arena, length * sizeof(uint32_t));
+
+	Bitset_Initialize(&(disk->fileClusters), disk->arena, length);
+	Bitset_Initialize(&(disk->referencedClusters), disk->arena, length);
+}
+
+ClusterChain* FATImage_GetClusterChain(FATImage* disk, size_t cluster)
+{
+	assert(disk != NULL);
+	assert(disk->clusterChainIds != NULL);
+
+	if(cluster >= disk->clustersLength || disk->clusterChainIds[cluster] == 0)
+		return NULL;
+	return disk->clusterChains + (disk->clusterChainIds[cluster] - 1);
+}
+
+bool FATImage_IsClusterLink(FATImage* disk, size_t value)
+{
+	// clustersLength covers the data clusters and the two reserved entries
+	return value >= 2 && value < disk->clustersLength;
+}
+
+static bool FATImage_IsFileStatus(uint8_t status)
+{
+	return status == File || status == FileLast;
+}
+
+/* true for a cluster in the middle of a file whose link leaves the data area or points at a cluster outside any file */
+static bool FATImage_IsBadLink(FATImage* disk, size_t cluster)
+{
+	uint32_t value = disk->clusterValues[cluster];
+	return disk->clusterStatuses[cluster] == File && (!FATImage_IsClusterLink(disk, value) || !FATImage_IsFileStatus(disk->clusterStatuses[value]));
+}
+
+void FATImage_AddChainFinding(FATImage* disk, ChainFindingType type, size_t head, size_t cluster, size_t target)
+{
+	assert(disk != NULL);
+
+	if(disk->chainFindingsLength >= disk->chainFindingsCapacity)
 	{
-		// realloc
-		disk->clusterChains = realloc(disk->clusterChains, 2 * disk->clusterChainsCapacity * sizeof(ClusterChain));
-		assert(disk->clusterChains != NULL);
-		memset(disk->clusterChains + disk->clusterChainsCapacity, 0, disk->clusterChainsCapacity * sizeof(ClusterChain) / sizeof(unsigned char));
-		disk->clusterChainsCapacity *= 2;
+		size_t capacity = disk->chainFindingsCapacity > 0 ? 2 * disk->chainFindingsCapacity : 16;
+		disk->chainFindings = Arena_Reallocate(disk->arena, disk->chainFindings, disk->chainFindingsCapacity * sizeof(ChainFinding), capacity * sizeof(ChainFinding));
+		disk->chainFindingsCapacity = capacity;
 	}
 
-	disk->clusterChainsLength += 1;
-	return disk->clusterChains + (disk->clusterChainsLength - 1);
+	ChainFinding* finding = disk->chainFindings + disk->chainFindingsLength;
+	finding->type = type;
+	finding->head = head;
+	finding->cluster = cluster;
+	finding->target = target;
+	disk->chainFindingsLength += 1;
 }
 
-void FATImage_ReadClusterIndexSequenceAndCreateFileChains(FATImage* disk)
+void FATImage_CreateFileChain(FATImage* disk, size_t head)
+{
+	uint32_t* values = disk->clusterValues;
+	uint8_t* statuses = disk->clusterStatuses;
+	uint32_t* chainIds = disk->clusterChainIds;
+
+	ClusterChain* newChain = FATImage_GetNewFileChain(disk);
+	assert(disk->clusterChainsLength < UINT32_MAX);
+	uint32_t newChainId = disk->clusterChainsLength;
+
+	// chain ids double as visit stamps: a cluster is claimed before its link is followed,
+	// so every cluster is visited at most once across all chains
+	size_t currentIndex = head;
+	while(true)
+	{
+		ClusterChain_Append(newChain, currentIndex);
+		chainIds[currentIndex] = newChainId;
+
+		uint32_t currentValue = values[currentIndex];
+		if(statuses[currentIndex] == FileLast)
+		{
+			// last file in chain, break
+			break;
+		}
+		else if(!FATImage_IsClusterLink(disk, currentValue))
+		{
+			LOG(INFO, "chain at %zd links %zd out of range to %u\n", head, currentIndex, currentValue);
+			FATImage_AddChainFinding(disk, ChainBadLink, head, currentIndex, currentValue);
+			break;
+		}
+		else if(!FATImage_IsFileStatus(statuses[currentValue]))
+		{
+			// free, reserved and bad clusters never become part of the chain
+			LOG(INFO, "chain at %zd links %zd to %u, which is not part of any file\n", head, currentIndex, currentValue);
+			FATImage_AddChainFinding(disk, ChainBadLink, head, currentIndex, currentValue);
+			break;
+		}
+		else if(chainIds[currentValue] == newChainId)
+		{
+			LOG(INFO, "chain at %zd links %zd back to %u\n", head, currentIndex, currentValue);
+			FATImage_AddChainFinding(disk, ChainCycle, head, currentIndex, currentValue);
+			break;
+		}
+		else if(chainIds[currentValue] != 0)
+		{
+			LOG(INFO, "chain at %zd links %zd into another chain at %u\n", head, currentIndex, currentValue);
+			FATImage_AddChainFinding(disk, ChainCrossLink, head, currentIndex, currentValue);
+			break;
+		}
+
+		// file continues, follow cluster index chain
+		currentIndex = currentValue;
+	}
+}
+
+void FATImage_SetOutput(FATImage* disk, FILE* output, int logLevel)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);
+	assert(output != NULL);
 
-	for(size_t index = 2; index < disk->clustersLength ; ++index)
+	Report_Flush(disk->report);
+	disk->output = output;
+	disk->logLevel = logLevel;
+	disk->report->output = output;
+}
+
+void FATImage_SetReportFormat(FATImage* disk, ReportFormat format)
+{
+	assert(disk != NULL);
+
+	Report_Flush(disk->report);
+	disk->report->format = format;
+}
+
+void FATImage_SetWorkerCount(FATImage* disk, size_t workerCount)
+{
+	assert(disk != NULL);
+
+	if(workerCount == 0)
 	{
-		uint16_t value = disk->clusters[index].rawTableValue;
-		if(value == 0x00)
-			disk->clusters[index].status = Unused;
-		else if(value >= 0xFF0 && value <= 0xFF6)
-			disk->clusters[index].status = Reserved;
-		else if(value == 0xFF7)
-			disk->clusters[index].status = Bad;
-		else
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		workerCount = online > 0 ? online : 1;
+	}
+	disk->workerCount = workerCount;
+}
+
+void FATImage_EnableStats(FATImage* disk, bool enabled)
+{
+	assert(disk != NULL);
+	disk->stats.enabled = enabled;
+}
+
+void FATImage_GetStats(FATImage* disk, FATImageStats* stats)
+{
+	assert(disk != NULL);
+	assert(stats != NULL);
+
+	*stats = disk->stats;
+	stats->arenaBytes = disk->arena->bytesAllocated;
+	stats->arenaBlocks = disk->arena->blocksAllocated;
+}
+
+const char* FATImage_PhaseName(FATImagePhase phase)
+{
+	static const char* const names[FATPhaseCount] =
+	{
+		"disk_information", "classify", "chains", "directories", "compare", "report", "repair", "save"
+	};
+	assert(phase < FATPhaseCount);
+	return names[phase];
+}
+
+void FATImage_PrintStats(FATImage* disk)
+{
+	assert(disk != NULL);
+
+	FATImageStats stats;
+	FATImage_GetStats(disk, &stats);
+	char name[64];
+	for(int phase = 0 ; phase < FATPhaseCount ; ++phase)
+	{
+		snprintf(name, sizeof(name), "%s_ns", FATImage_PhaseName(phase));
+		Report_AddNamed(disk->report, ReportStatistic, name, stats.phaseNanoseconds[phase], 0);
+	}
+
+	struct { const char* name; size_t value; } counters[] =
+	{
+		{ "clusters_classified", stats.clustersClassified },
+		{ "chains_built", stats.chainsBuilt },
+		{ "extents_allocated", stats.extentsAllocated },
+		{ "directory_entries_parsed", stats.directoryEntriesParsed },
+		{ "bytes_written", stats.bytesWritten },
+		{ "bytes_synced", stats.bytesSynced },
+		{ "arena_bytes", stats.arenaBytes },
+		{ "arena_blocks", stats.arenaBlocks }
+	};
+	for(size_t counter = 0 ; counter < sizeof(counters) / sizeof(counters[0]) ; ++counter)
+		Report_AddNamed(disk->report, ReportStatistic, counters[counter].name, counters[counter].value, 0);
+	Report_Flush(disk->report);
+}
+
+/* Range [first, end) of work done by one worker, with results kept per worker until all workers are done */
+typedef struct
+{
+	FATImage* disk;
+	void* context;
+	size_t first;
+	size_t end;
+	size_t statusCounts[MAX];
+	bool flag;
+} FATImageSlab;
+
+/* Splits [0, length) into one slab per worker, each starting on a multiple of alignment, and runs function on
+ * every slab, the calling thread taking the first one itself. Caller merges the results and frees the slabs. */
+FATImageSlab* FATImage_RunSlabs(FATImage* disk, size_t length, size_t alignment, void* (*function)(void*), void* context, size_t* slabCount)
+{
+	size_t units = (length + alignment - 1) / alignment;
+	size_t workers = disk->workerCount < units ? disk->workerCount : units;
+	if(workers == 0)
+		workers = 1;
+	size_t slabLength = (units + workers - 1) / workers * alignment;
+
+	FATImageSlab* slabs = calloc(workers, sizeof(FATImageSlab));
+	pthread_t* threads = calloc(workers, sizeof(pthread_t));
+	assert(slabs != NULL && threads != NULL);
+	for(size_t worker = 0 ; worker < workers ; ++worker)
+	{
+		slabs[worker].disk = disk;
+		slabs[worker].context = context;
+		slabs[worker].first = worker * slabLength < length ? worker * slabLength : length;
+		slabs[worker].end = slabs[worker].first + slabLength < length ? slabs[worker].first + slabLength : length;
+	}
+
+	for(size_t worker = 1 ; worker < workers ; ++worker)
+	{
+		int error = pthread_create(threads + worker, NULL, function, slabs + worker);
+		assert(error == 0);
+	}
+	function(slabs);
+	for(size_t worker = 1 ; worker < workers ; ++worker)
+		pthread_join(threads[worker], NULL);
+
+	free(threads);
+	*slabCount = workers;
+	return slabs;
+}
+
+/* Decodes the blocks of the slab that have not been decoded yet, then classifies its clusters. Slabs start
+ * on block boundaries, so workers never share a byte of the table or a word of the bitsets they write. */
+void* FATImage_DecodeAndClassifySlab(void* argument)
+{
+	FATImageSlab* slab = argument;
+	FATImage* disk = slab->disk;
+	uint32_t* values = disk->clusterValues;
+	uint8_t* statuses = disk->clusterStatuses;
+	FileAllocationTable* table = &(disk->table);
+
+	for(size_t block = slab->first / CLUSTER_BLOCK ; block * CLUSTER_BLOCK < slab->end ; ++block)
+	{
+		if(!Bitset_Test(&(disk->decodedClusterBlocks), block))
 		{
-			// part of file
-			if(disk->clusters[index].clusterChain != NULL)
+			size_t first = block * CLUSTER_BLOCK;
+			size_t count = slab->end - first < CLUSTER_BLOCK ? slab->end - first : CLUSTER_BLOCK;
+			FileAllocationTable_Decode(table, first, count, values + first);
+		}
+	}
+
+	for(size_t index = slab->first < 2 ? 2 : slab->first ; index < slab->end ; ++index)
+	{
+		statuses[index] = FATImage_ClassifyValue(table, values[index]);
+		slab->statusCounts[statuses[index]] += 1;
+		if(statuses[index] == File || statuses[index] == FileLast)
+			Bitset_Set(&(disk->fileClusters), index);
+	}
+	return NULL;
+}
+
+void FATImage_DecodeAndClassifyClusters(FATImage* disk)
+{
+	assert(disk != NULL);
+	assert(disk->clusterStatuses != NULL);
+	STATS_START();
+
+	size_t slabCount;
+	FATImageSlab* slabs = FATImage_RunSlabs(disk, disk->clustersLength, CLUSTER_BLOCK, FATImage_DecodeAndClassifySlab, NULL, &slabCount);
+	for(size_t slab = 0 ; slab < slabCount ; ++slab)
+	{
+		for(int status = MIN ; status < MAX ; ++status)
+			disk->clusterStatusCounts[status] += slabs[slab].statusCounts[status];
+	}
+	Bitset_SetRange(&(disk->decodedClusterBlocks), 0, disk->decodedClusterBlocks.length);
+	free(slabs);
+	STATS_ADD(clustersClassified, disk->clustersLength);
+	STATS_STOP(FATPhaseClassify);
+}
+
+/* Scratch state of the parallel chain builder */
+typedef struct
+{
+	uint8_t* inDegrees;
+	uint32_t* next;
+	uint32_t* nextScratch;
+	uint32_t* distance;
+	uint32_t* distanceScratch;
+	size_t* chainOffsets;
+	uint32_t* order;
+	size_t* extentCounts;
+} FATImageChainBuild;
+
+/* Flags links the pointer jumping builder cannot reproduce the serial builder for (cross-links), and points
+ * every cluster at its successor, or at itself for last clusters and clusters with bad links, which end their chain */
+void* FATImage_LinkSlab(void* argument)
+{
+	FATImageSlab* slab = argument;
+	FATImageChainBuild* build = slab->context;
+	FATImage* disk = slab->disk;
+	uint8_t* statuses = disk->clusterStatuses;
+
+	for(size_t index = slab->first ; index < slab->end ; ++index)
+	{
+		uint32_t value = disk->clusterValues[index];
+		bool linked = index >= 2 && statuses[index] == File && !FATImage_IsBadLink(disk, index);
+		if(linked && build->inDegrees[value] != 1)
+			slab->flag = true;
+
+		build->next[index] = linked ? value : index;
+		build->distance[index] = linked ? 1 : 0;
+	}
+	return NULL;
+}
+
+/* One pointer jumping round: every cluster skips ahead to its successor's successor */
+void* FATImage_JumpSlab(void* argument)
+{
+	FATImageSlab* slab = argument;
+	FATImageChainBuild* build = slab->context;
+
+	for(size_t index = slab->first ; index < slab->end ; ++index)
+	{
+		uint32_t next = build->next[index];
+		build->nextScratch[index] = build->next[next];
+		build->distanceScratch[index] = build->distance[index] + build->distance[next];
+		if(build->nextScratch[index] != next)
+			slab->flag = true;
+	}
+	return NULL;
+}
+
+/* Flags file clusters that do not reach a last cluster or a bad link, which only happens on cycles */
+void* FATImage_CheckTailsSlab(void* argument)
+{
+	FATImageSlab* slab = argument;
+	FATImageChainBuild* build = slab->context;
+	FATImage* disk = slab->disk;
+	uint8_t* statuses = disk->clusterStatuses;
+
+	for(size_t index = slab->first < 2 ? 2 : slab->first ; index < slab->end ; ++index)
+	{
+		uint32_t tail = build->next[index];
+		if(FATImage_IsFileStatus(statuses[index]) && statuses[tail] != FileLast && !FATImage_IsBadLink(disk, tail))
+			slab->flag = true;
+	}
+	return NULL;
+}
+
+/* Stores the chain id of every file cluster, and scatters it to its position in the chain order.
+ * nextScratch holds the chain id of each tail. */
+void* FATImage_ScatterSlab(void* argument)
+{
+	FATImageSlab* slab = argument;
+	FATImageChainBuild* build = slab->context;
+	FATImage* disk = slab->disk;
+
+	for(size_t index = slab->first < 2 ? 2 : slab->first ; index < slab->end ; ++index)
+	{
+		if(!FATImage_IsFileStatus(disk->clusterStatuses[index]))
+			continue;
+
+		uint32_t chainId = build->nextScratch[build->next[index]];
+		size_t first = build->chainOffsets[chainId - 1];
+		size_t length = build->chainOffsets[chainId] - first;
+		disk->clusterChainIds[index] = chainId;
+		build->order[first + length - 1 - build->distance[index]] = index;
+	}
+	return NULL;
+}
+
+/* Counts the extents of every chain in the slab (slabs range over chains, not clusters) */
+void* FATImage_CountExtentsSlab(void* argument)
+{
+	FATImageSlab* slab = argument;
+	FATImageChainBuild* build = slab->context;
+
+	for(size_t chain = slab->first ; chain < slab->end ; ++chain)
+	{
+		size_t extents = 1;
+		for(size_t position = build->chainOffsets[chain] + 1 ; position < build->chainOffsets[chain + 1] ; ++position)
+		{
+			if(build->order[position] != build->order[position - 1] + 1)
+				++extents;
+		}
+		build->extentCounts[chain] = extents;
+	}
+	return NULL;
+}
+
+/* Appends the clusters of every chain in the slab, extents have been reserved so nothing is allocated */
+void* FATImage_FillChainsSlab(void* argument)
+{
+	FATImageSlab* slab = argument;
+	FATImageChainBuild* build = slab->context;
+
+	for(size_t chain = slab->first ; chain < slab->end ; ++chain)
+	{
+		ClusterChain* clusterChain = slab->disk->clusterChains + chain;
+		for(size_t position = build->chainOffsets[chain] ; position < build->chainOffsets[chain + 1] ; ++position)
+			ClusterChain_Append(clusterChain, build->order[position]);
+	}
+	return NULL;
+}
+
+/* Runs function on every slab, returns true if any slab raised its flag */
+static bool FATImage_RunSlabsFlagged(FATImage* disk, size_t length, size_t alignment, void* (*function)(void*), void* context)
+{
+	size_t slabCount;
+	FATImageSlab* slabs = FATImage_RunSlabs(disk, length, alignment, function, context, &slabCount);
+	bool flagged = false;
+	for(size_t slab = 0 ; slab < slabCount ; ++slab)
+		flagged = flagged || slabs[slab].flag;
+	free(slabs);
+	return flagged;
+}
+
+/* Builds the same chains and bad link findings as the serial builder, with pointer jumping instead of walking chains.
+ * Returns false without touching any chain state if the table has cross-links or cycles, which the serial builder
+ * reports as findings. */
+bool FATImage_CreateFileChainsParallel(FATImage* disk, uint8_t* inDegrees)
+{
+	size_t length = disk->clustersLength;
+	FATImageChainBuild build = { .inDegrees = inDegrees };
+	build.next = malloc(length * sizeof(uint32_t));
+	build.nextScratch = malloc(length * sizeof(uint32_t));
+	build.distance = malloc(length * sizeof(uint32_t));
+	build.distanceScratch = malloc(length * sizeof(uint32_t));
+	assert(build.next != NULL && build.nextScratch != NULL && build.distance != NULL && build.distanceScratch != NULL);
+
+	bool clean = !FATImage_RunSlabsFlagged(disk, length, CLUSTER_BLOCK, FATImage_LinkSlab, &build);
+
+	// after round k every cluster points 2^k clusters ahead (or at its tail), so log2(length) rounds reach every tail
+	bool changed = clean;
+	for(size_t round = 0 ; changed && ((size_t)1 << round) < 2 * length ; ++round)
+	{
+		changed = FATImage_RunSlabsFlagged(disk, length, CLUSTER_BLOCK, FATImage_JumpSlab, &build);
+
+		uint32_t* swap = build.next;
+		build.next = build.nextScratch;
+		build.nextScratch = swap;
+		swap = build.distance;
+		build.distance = build.distanceScratch;
+		build.distanceScratch = swap;
+	}
+	clean = clean && !FATImage_RunSlabsFlagged(disk, length, CLUSTER_BLOCK, FATImage_CheckTailsSlab, &build);
+
+	if(clean)
+	{
+		// chain ids follow head order, exactly as the serial builder hands them out
+		size_t chains = 0;
+		for(size_t index = 2 ; index < length ; ++index)
+			chains += FATImage_IsFileStatus(disk->clusterStatuses[index]) && inDegrees[index] == 0;
+
+		build.chainOffsets = malloc((chains + 1) * sizeof(size_t));
+		build.extentCounts = malloc((chains + 1) * sizeof(size_t));
+		assert(build.chainOffsets != NULL && build.extentCounts != NULL);
+		build.chainOffsets[0] = 0;
+		for(size_t index = 2 ; index < length ; ++index)
+		{
+			if(FATImage_IsFileStatus(disk->clusterStatuses[index]) && inDegrees[index] == 0)
 			{
-				// already traversed
-				continue;
+				FATImage_GetNewFileChain(disk);
+				assert(disk->clusterChainsLength < UINT32_MAX);
+				build.nextScratch[build.next[index]] = disk->clusterChainsLength;
+				build.chainOffsets[disk->clusterChainsLength] = build.chainOffsets[disk->clusterChainsLength - 1] + build.distance[index] + 1;
 			}
-				
-			ClusterChain* newChain = FATImage_GetNewFileChain(disk);
+		}
 
-			size_t currentIndex = index;
-			while(true)
+		build.order = malloc((build.chainOffsets[chains] + 1) * sizeof(uint32_t));
+		assert(build.order != NULL);
+		FATImage_RunSlabsFlagged(disk, length, CLUSTER_BLOCK, FATImage_ScatterSlab, &build);
+		FATImage_RunSlabsFlagged(disk, chains, 1, FATImage_CountExtentsSlab, &build);
+		for(size_t chain = 0 ; chain < chains ; ++chain)
+			ClusterChain_Reserve(disk->clusterChains + chain, build.extentCounts[chain]);
+		FATImage_RunSlabsFlagged(disk, chains, 1, FATImage_FillChainsSlab, &build);
+
+		// chains ending in a bad link, in chain order like the serial builder records them
+		for(size_t chain = 0 ; chain < chains ; ++chain)
+		{
+			size_t head = build.order[build.chainOffsets[chain]];
+			size_t tail = build.order[build.chainOffsets[chain + 1] - 1];
+			if(FATImage_IsBadLink(disk, tail))
 			{
-				uint16_t currentValue = disk->clusters[currentIndex].rawTableValue;
-				if(currentValue >= 0xFF8 && currentValue <= 0xFFF)
-				{
-					ClusterChain_Append(newChain, currentIndex);
-					disk->clusters[currentIndex].clusterChain = newChain;
-					disk->clusters[currentIndex].status = FileLast;
+				LOG(INFO, "chain at %zd links %zd to %u, which is out of range or not part of any file\n", head, tail, disk->clusterValues[tail]);
+				FATImage_AddChainFinding(disk, ChainBadLink, head, tail, disk->clusterValues[tail]);
+			}
+		}
 
-					// last file in chain, break
-					break;
-				}
-				else if(currentValue >= 2 && currentValue < 2 + disk->information.dataSectorCount)
-				{
-					ClusterChain_Append(newChain, currentIndex);
-					disk->clusters[currentIndex].clusterChain = newChain;
-					disk->clusters[currentIndex].status = File;
+		free(build.chainOffsets);
+		free(build.extentCounts);
+		free(build.order);
+	}
+
+	free(build.next);
+	free(build.nextScratch);
+	free(build.distance);
+	free(build.distanceScratch);
+	return clean;
+}
+
+void FATImage_ReadClusterIndexSequenceAndCreateFileChains(FATImage* disk)
+{
+	assert(disk != NULL);
+	assert(disk->clusterStatuses != NULL);
+
+	uint32_t* values = disk->clusterValues;
+	uint8_t* statuses = disk->clusterStatuses;
+	uint32_t* chainIds = disk->clusterChainIds;
+
+	FATImage_DecodeAndClassifyClusters(disk);
+	STATS_START();
+
+	// count predecessors (saturating at 2) of every file cluster
+	uint8_t* inDegrees = calloc(disk->clustersLength, sizeof(uint8_t));
+	assert(inDegrees != NULL);
+	for(size_t index = 2; index < disk->clustersLength ; ++index)
+	{
+		uint32_t value = values[index];
+		if(statuses[index] == File && FATImage_IsClusterLink(disk, value) && inDegrees[value] < 2)
+			inDegrees[value] += 1;
+	}
+
+	// every head starts a chain, so the chain array is sized once, with some room for chains only reachable from cycles
+	size_t heads = 0;
+	for(size_t index = 2; index < disk->clustersLength ; ++index)
+		heads += (statuses[index] == File || statuses[index] == FileLast) && inDegrees[index] == 0;
+	FATImage_ReserveFileChains(disk, disk->clusterChainsLength + heads + heads / 16 + 16);
+
+	// with several workers, tables without cross-links or cycles are built by pointer jumping, anything else falls back to walking chains
+	if(disk->workerCount <= 1 || !FATImage_CreateFileChainsParallel(disk, inDegrees))
+	{
+		// chains start at file clusters without predecessors
+		for(size_t index = 2; index < disk->clustersLength ; ++index)
+		{
+			bool isFile = statuses[index] == File || statuses[index] == FileLast;
+			if(isFile && inDegrees[index] == 0)
+				FATImage_CreateFileChain(disk, index);
+		}
 
-					// file continues, follow cluster index chain
-					currentIndex = currentValue;
-				}
-				else
-				{
-					printf("encountered error traversing index chain in file allocation table...\n");
-					break;
-				}
-			}
+		// any file clusters left over are only reachable from cycles
+		for(size_t index = 2; index < disk->clustersLength ; ++index)
+		{
+			bool isFile = statuses[index] == File || statuses[index] == FileLast;
+			if(isFile && chainIds[index] == 0)
+				FATImage_CreateFileChain(disk, index);
 		}
 	}
+	free(inDegrees);
+	STATS_ADD(chainsBuilt, disk->clusterChainsLength);
+	if(disk->stats.enabled)
+	{
+		for(size_t index = 0 ; index < disk->clusterChainsLength ; ++index)
+			disk->stats.extentsAllocated += disk->clusterChains[index].extentsLength;
+	}
+	STATS_STOP(FATPhaseChains);
 
 	LOG(INFO, "Found %zd files...\n", disk->clusterChainsLength);
+	if(!LOG_ENABLED(DETAIL))
+		return;
+
+	// the dump only feeds log messages, so it is compiled out along with them
 	for(size_t index = 0 ; index < disk->clusterChainsLength ; ++index)
 	{
 		LOG(DETAIL, "File with %zd clusters:\n", disk->clusterChains[index].length);
-		if(disk->clusterChains[index].length > 0)
+		ClusterChain* chain = disk->clusterChains + index;
+		for(size_t extent = 0 ; extent < chain->extentsLength ; ++extent)
 		{
-			ClusterChainNode* node = disk->clusterChains[index].head;
-			LOG(DEBUG, "\t%zd", node->index);
-			node = node->next;
-			while(node)
+			size_t start = chain->extents[extent].start;
+			size_t end = start + chain->extents[extent].length;
+			for(size_t cluster = start ; cluster < end ; ++cluster)
 			{
-				LOG(DEBUG, " > %zd", node->index);
-				node = node->next;
+				LOG(DEBUG, extent == 0 && cluster == start ? "\t%zd" : " > %zd", cluster);
 			}
 		}
 		LOG(DEBUG, "\n");
 	}
 }
 
+void FATImage_LinkDirectoryEntry(FATImage* disk, ClusterChain* chain, DirectoryEntry* entry)
+{
+	assert(disk != NULL);
+	assert(chain != NULL);
+
+	chain->directoryEntry = entry;
+	for(size_t extent = 0 ; extent < chain->extentsLength ; ++extent)
+		Bitset_SetRange(&(disk->referencedClusters), chain->extents[extent].start, chain->extents[extent].length);
+}
+
 DirectoryEntry* FATImage_GetNewDirectoryEntry(FATImage* disk)
 {
 	assert(disk != NULL);
@@ -222,51 +1096,81 @@ DirectoryEntry* FATImage_GetNewDirectoryEntry(FATImage* disk)
 	
 	if(disk->directoryEntriesLength >= disk->directoryEntriesCapacity)
 	{
-		// realloc
-		disk->directoryEntries = realloc(disk->directoryEntries, 2 * disk->directoryEntriesCapacity * sizeof(DirectoryEntry));
+		// grow into a new array, rebasing the pointers chains and entries hold into the old one
+		DirectoryEntry* old = disk->directoryEntries;
+		uintptr_t oldStart = (uintptr_t)old;
+		uintptr_t oldEnd = (uintptr_t)(old + disk->directoryEntriesCapacity);
+
+		disk->directoryEntries = calloc(2 * disk->directoryEntriesCapacity, sizeof(DirectoryEntry));
 		assert(disk->directoryEntries != NULL);
-		memset(disk->directoryEntries + disk->directoryEntriesCapacity, 0, disk->directoryEntriesCapacity * sizeof(DirectoryEntry) / sizeof(unsigned char));
+		memcpy(disk->directoryEntries, old, disk->directoryEntriesCapacity * sizeof(DirectoryEntry));
 		disk->directoryEntriesCapacity *= 2;
+
+		for(size_t index = 0 ; index < disk->clusterChainsLength ; ++index)
+		{
+			ClusterChain* chain = disk->clusterChains + index;
+			if((uintptr_t)chain->directoryEntry >= oldStart && (uintptr_t)chain->directoryEntry < oldEnd)
+				chain->directoryEntry = disk->directoryEntries + (chain->directoryEntry - old);
+		}
+		for(size_t index = 0 ; index < disk->directoryEntriesLength ; ++index)
+		{
+			DirectoryEntry* entry = disk->directoryEntries + index;
+			if(entry->parent != NULL)
+				entry->parent = disk->directoryEntries + (entry->parent - old);
+		}
+		free(old);
 	}
 
 	disk->directoryEntriesLength += 1;
 	return disk->directoryEntries + (disk->directoryEntriesLength - 1);
 }
 
-DirectoryEntry* FATImage_InitializeNewDirectoryEntry(FATImage* disk, uint8_t* directoryEntry, size_t directoryEntrySize)
+void FATImage_ParseDirectoryEntry(uint8_t* directoryEntry, size_t directoryEntrySize, DirectoryEntry* entry)
 {
-	assert(disk != NULL);
-	assert(disk->directoryEntries != NULL);
+	assert(directoryEntry != NULL);
 	assert(directoryEntrySize == 32);
+	assert(entry != NULL);
 
-	DirectoryEntry* entry = FATImage_GetNewDirectoryEntry(disk);
-
-	entry->filename = calloc(9, sizeof(char));
-	assert(entry->filename != NULL);
+	memcpy(entry->name, directoryEntry, sizeof(entry->name));
 	CopyUntilFirstSpace((char*)directoryEntry, 8, entry->filename);
-
-	entry->extension = calloc(4, sizeof(char));
-	assert(entry->extension != NULL);
 	CopyUntilFirstSpace((char*)directoryEntry + 8, 3, entry->extension);
 
 	entry->attributes = directoryEntry[11];
 	entry->startCluster = NumberFrom8BitLittleEndianSequence(directoryEntry + 26, 2);
 	entry->fileSize = NumberFrom8BitLittleEndianSequence(directoryEntry + 28, 4);
-	
+}
+
+DirectoryEntry* FATImage_InitializeNewDirectoryEntry(FATImage* disk, uint8_t* directoryEntry, size_t directoryEntrySize)
+{
+	assert(disk != NULL);
+	assert(disk->directoryEntries != NULL);
+
+	DirectoryEntry* entry = FATImage_GetNewDirectoryEntry(disk);
+	FATImage_ParseDirectoryEntry(directoryEntry, directoryEntrySize, entry);
 	return entry;
 }
 
-void FATImage_ReadDirectoryEntries_Internal(FATImage* disk, size_t sector, DirectoryEntry* parent)
+void FATImage_ReadDirectoryChain(FATImage* disk, size_t startCluster, size_t parent);
+
+/* parent is 0 for the root directory, otherwise the index of the parent directory entry + 1,
+ * returns true once the end of directory marker has been read */
+bool FATImage_ReadDirectoryEntries_Internal(FATImage* disk, size_t sector, size_t parent)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);	
+	assert(disk->clusterStatuses != NULL);	
 
 	size_t sectorSize = disk->information.sectorSize;
 	size_t directoryEntrySize = 32;
 	size_t directoryEntryCount = sectorSize / directoryEntrySize;
+	uint8_t* rawSector = FATImage_Access(disk, sectorSize * sector, sectorSize);
+	if(rawSector == NULL)
+	{
+		// the read error is in the report, the rest of the directory cannot be reached
+		return true;
+	}
 	for(size_t index = 0 ; index < directoryEntryCount ; ++index) 
 	{
-		uint8_t* rawDirectoryEntry = &(disk->image[sectorSize * sector + index * directoryEntrySize]);
+		uint8_t* rawDirectoryEntry = rawSector + index * directoryEntrySize;
 		uint8_t firstByte = rawDirectoryEntry[0];
 		if(firstByte == 0xE5)
 		{
@@ -276,21 +1180,24 @@ void FATImage_ReadDirectoryEntries_Internal(FATImage* disk, size_t sector, Direc
 		else if(firstByte == 0x00)
 		{
 			// last directory entry in sector
-			if(parent == NULL && disk->lastRootDirectoryEntry == NULL)
+			if(parent == 0 && disk->lastRootDirectoryEntry == NULL)
 			{
 				LOG(DEBUG, "last root directory entry is %zd\n", sectorSize * sector + index * directoryEntrySize);
 				disk->lastRootDirectoryEntry = rawDirectoryEntry;
 			}
-			break;
+			return true;
 		}
 		else
 		{
-			DirectoryEntry* entry = FATImage_InitializeNewDirectoryEntry(disk, rawDirectoryEntry, directoryEntrySize);
-			entry->parent = parent;
+			// parse onto the stack first, so skipped entries never take up a slot
+			DirectoryEntry parsed = { 0 };
+			FATImage_ParseDirectoryEntry(rawDirectoryEntry, directoryEntrySize, &parsed);
+			if(disk->table.type == FAT32)
+				parsed.startCluster |= NumberFrom8BitLittleEndianSequence(rawDirectoryEntry + 20, 2) << 16;
 
-			LOG(INFO, "found file %s EXT %s of size %zd\n", entry->filename, entry->extension, entry->fileSize);
+			LOG(INFO, "found file %s EXT %s of size %zd\n", parsed.filename, parsed.extension, parsed.fileSize);
 
-			char* filename = entry->filename;
+			char* filename = parsed.filename;
 			bool delete = true;
 			while(true)
 			{
@@ -304,30 +1211,53 @@ void FATImage_ReadDirectoryEntries_Internal(FATImage* disk, size_t sector, Direc
 				filename++;
 			}
 
-			if(delete || DirectoryEntry_IsVolumeLabel(entry))
+			if(delete || DirectoryEntry_IsVolumeLabel(&parsed))
 			{
 				LOG(INFO, "skipping file (is volume label OR has dots)\n");
-				free(entry->filename);
-				free(entry->extension);
-				memset(entry, 0, sizeof(DirectoryEntry) / sizeof(unsigned char));
-				disk->directoryEntriesLength -= 1;
 				continue;
 			}
+
+			DirectoryEntry* entry = FATImage_GetNewDirectoryEntry(disk);
+			*entry = parsed;
+			entry->parent = parent > 0 ? disk->directoryEntries + (parent - 1) : NULL;
 			
-			Cluster* cluster  = disk->clusters + entry->startCluster;
-			if(cluster->clusterChain && cluster->clusterChain->head->index == entry->startCluster)
+			// a directory chain that is already linked has been read, following it again would never end
+			bool linked = false;
+			ClusterChain* chain = FATImage_GetClusterChain(disk, entry->startCluster);
+			if(chain && ClusterChain_Head(chain) == entry->startCluster)
 			{
-				LOG(DETAIL, "found matching cluster chain of length %zd!\n", cluster->clusterChain->length);
-				cluster->clusterChain->directoryEntry = entry;
+				LOG(DETAIL, "found matching cluster chain of length %zd!\n", chain->length);
+				linked = chain->directoryEntry != NULL;
+				FATImage_LinkDirectoryEntry(disk, chain, entry);
 			}
 
-			if(DirectoryEntry_IsSubdirectory(entry))
+			if(DirectoryEntry_IsSubdirectory(entry) && !linked)
 			{
-				LOG(DETAIL, "following directory %s to %zd = cluster %zd\n", entry->filename, entry->startCluster, disk->information.dataSectorStartSector - 2 + entry->startCluster);
-				FATImage_ReadDirectoryEntries_Internal(disk, disk->information.dataSectorStartSector - 2 + entry->startCluster, entry);
+				LOG(DETAIL, "following directory %s to cluster %zd\n", entry->filename, entry->startCluster);
+				size_t entryIndex = entry - disk->directoryEntries;
+				FATImage_ReadDirectoryChain(disk, entry->startCluster, entryIndex + 1);
 			}
+		}
+	}
+	return false;
+}
 
-			
+/* reads every sector of every cluster in the chain starting at startCluster, until the end of directory marker */
+void FATImage_ReadDirectoryChain(FATImage* disk, size_t startCluster, size_t parent)
+{
+	assert(disk != NULL);
+
+	ClusterChain* chain = FATImage_GetClusterChain(disk, startCluster);
+	if(chain == NULL || ClusterChain_Head(chain) != startCluster)
+		return;
+
+	for(ClusterChainIterator it = ClusterChain_Begin(chain) ; ClusterChainIterator_IsValid(&it) ; ClusterChainIterator_Next(&it))
+	{
+		size_t sector = FATImage_ClusterToSector(disk, it.index);
+		for(size_t offset = 0 ; offset < disk->information.sectorsPerCluster ; ++offset)
+		{
+			if(FATImage_ReadDirectoryEntries_Internal(disk, sector + offset, parent))
+				return;
 		}
 	}
 }
@@ -335,80 +1265,394 @@ void FATImage_ReadDirectoryEntries_Internal(FATImage* disk, size_t sector, Direc
 void FATImage_ReadDirectoryEntries(FATImage* disk)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);	
+	assert(disk->clusterStatuses != NULL);	
+	STATS_START();
+	size_t entries = disk->directoryEntriesLength;
+
+	// FAT32 keeps the root directory in a cluster chain, FAT12 and FAT16 in a fixed region
+	if(disk->table.type == FAT32)
+	{
+		size_t rootCluster = disk->information.rootDirectoryCluster;
+		ClusterChain* chain = FATImage_GetClusterChain(disk, rootCluster);
+		if(chain && ClusterChain_Head(chain) == rootCluster)
+		{
+			disk->rootDirectory.attributes = 0x10; // subdirectory
+			disk->rootDirectory.startCluster = rootCluster;
+			FATImage_LinkDirectoryEntry(disk, chain, &(disk->rootDirectory));
+		}
+		FATImage_ReadDirectoryChain(disk, rootCluster, 0);
+	}
+	else
+	{
+		for(size_t index = 0 ; index < disk->information.rootDirectorySectorCount ; ++index)
+		{
+			if(FATImage_ReadDirectoryEntries_Internal(disk, disk->information.rootDirectoryStartSector + index, 0))
+				break;
+		}
+	}
 
-	for(size_t index = 0 ; index < disk->information.rootDirectorySectorCount ; ++index)
-		FATImage_ReadDirectoryEntries_Internal(disk, disk->information.rootDirectoryStartSector + index, NULL);
+	// directory clusters are parsed, drop them from the mapping unless dropping would discard private modifications
+	if(disk->dirtyRangesLength == 0)
+	{
+		size_t dataStart = disk->information.dataSectorStartSector * disk->information.sectorSize;
+		FATImage_AdviseRange(disk, dataStart, disk->imageSize - dataStart, MADV_DONTNEED);
+	}
+	STATS_ADD(directoryEntriesParsed, disk->directoryEntriesLength - entries);
+	STATS_STOP(FATPhaseDirectories);
+}
+
+size_t FATImage_ClusterValuesLength(FATImage* disk)
+{
+	size_t clusters = disk->information.clusterCount + 2;
+	return clusters < disk->table.entryCount ? clusters : disk->table.entryCount;
+}
+
+void FATImage_DecodeClusterBlock(FATImage* disk, size_t block)
+{
+	size_t first = block * CLUSTER_BLOCK;
+	size_t count = disk->clustersLength - first < CLUSTER_BLOCK ? disk->clustersLength - first : CLUSTER_BLOCK;
+	FileAllocationTable_Decode(&(disk->table), first, count, disk->clusterValues + first);
+	Bitset_Set(&(disk->decodedClusterBlocks), block);
 }
 
 void FATImage_ReadFileAllocationTable(FATImage* disk)
 {
 	assert(disk != NULL);
-	assert(disk->clusters == NULL);
+	assert(disk->clusterStatuses == NULL);
 
-	/* Retrieve values */
-	size_t sectors = disk->information.sectorCount;
-	uint16_t* tableIndices = calloc(disk->information.sectorCount, sizeof(uint16_t));
-	assert(tableIndices != NULL);
-	Read12BitLittleEndianSequence(disk->image + 512, sectors * 3 / 2, tableIndices, sectors);
+	/* Retrieve values for the data clusters and the two reserved entries, decoding straight into the cluster value column.
+	 * Blocks that no lazy lookup has decoded yet are decoded by the workers classifying them. */
+	FATImage_AllocateClusters(disk, FATImage_ClusterValuesLength(disk));
+	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
+}
+
+uint32_t FATImage_GetNextCluster(FATImage* disk, size_t cluster)
+{
+	assert(disk != NULL);
+	assert(disk->table.base != NULL || disk->clusterValues != NULL);
 
-	disk->clusters = calloc(sectors, sizeof(Cluster));
-	assert(disk->clusters != NULL);
-	disk->clustersLength = sectors;
+	if(disk->clusterValues == NULL)
+		FATImage_AllocateClusterValues(disk, FATImage_ClusterValuesLength(disk));
+	assert(cluster < disk->clustersLength);
 
-	for(size_t index = 0 ; index < sectors ; ++index)
-		disk->clusters[index].rawTableValue = tableIndices[index];
-	free(tableIndices);
+	size_t block = cluster / CLUSTER_BLOCK;
+	if(!Bitset_Test(&(disk->decodedClusterBlocks), block))
+		FATImage_DecodeClusterBlock(disk, block);
+	return disk->clusterValues[cluster];
+}
 
-	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
+bool FATImage_ReadClusterChain(FATImage* disk, size_t start, ClusterChain* chain)
+{
+	assert(disk != NULL);
+	assert(chain != NULL);
+
+	if(disk->clusterValues == NULL)
+		FATImage_AllocateClusterValues(disk, FATImage_ClusterValuesLength(disk));
+	if(!FATImage_IsClusterLink(disk, start))
+		return false;
+
+	// clusters already in the chain, only the pages of visited clusters are ever touched
+	Bitset visited;
+	visited.length = disk->clustersLength;
+	visited.words = calloc((visited.length + 63) / 64, sizeof(uint64_t));
+	assert(visited.words != NULL);
+
+	bool ended = false;
+	size_t cluster = start;
+	while(true)
+	{
+		ClusterChain_Append(chain, cluster);
+		Bitset_Set(&visited, cluster);
+
+		uint32_t next = FATImage_GetNextCluster(disk, cluster);
+		if(next >= disk->table.endOfChainMin && next <= disk->table.endOfChain)
+		{
+			ended = true;
+			break;
+		}
+		if(!FATImage_IsClusterLink(disk, next) || Bitset_Test(&visited, next))
+			break;
+
+		// free, reserved and bad clusters never become part of the chain
+		uint32_t target = FATImage_GetNextCluster(disk, next);
+		if(target == 0x00 || (target >= disk->table.reservedMin && target <= disk->table.bad))
+			break;
+		cluster = next;
+	}
+
+	free(visited.words);
+	return ended;
+}
+
+void FATImage_GetClusterUsage(FATImage* disk, FATClusterUsage* usage)
+{
+	assert(disk != NULL);
+	assert(disk->clusterStatuses != NULL);
+	assert(usage != NULL);
+
+	usage->clusters = disk->clustersLength > 2 ? disk->clustersLength - 2 : 0;
+	usage->free = disk->clusterStatusCounts[Unused];
+	usage->reserved = disk->clusterStatusCounts[Reserved];
+	usage->bad = disk->clusterStatusCounts[Bad];
+	usage->file = Bitset_Count(&(disk->fileClusters));
+	usage->referenced = Bitset_Count(&(disk->referencedClusters));
+	usage->unreferenced = Bitset_CountAndNot(&(disk->fileClusters), &(disk->referencedClusters));
+}
+
+size_t FATImage_GetUnreferencedClusters(FATImage* disk, size_t* destination, size_t destinationLength)
+{
+	assert(disk != NULL);
+	assert(disk->clusterStatuses != NULL);
+
+	size_t found = 0;
+	size_t cluster = Bitset_NextAndNot(&(disk->fileClusters), &(disk->referencedClusters), 0);
+	while(cluster < disk->clustersLength)
+	{
+		if(found < destinationLength)
+			destination[found] = cluster;
+		found += 1;
+		cluster = Bitset_NextAndNot(&(disk->fileClusters), &(disk->referencedClusters), cluster + 1);
+	}
+	return found;
+}
+
+void FATImage_PrintChainFindings(FATImage* disk)
+{
+	assert(disk != NULL);
+	assert(disk->clusterStatuses != NULL);
+	STATS_START();
+
+	for(size_t index = 0 ; index < disk->chainFindingsLength ; ++index)
+	{
+		ChainFinding* finding = disk->chainFindings + index;
+		ReportRecordType type = finding->type == ChainCycle ? ReportCycle : finding->type == ChainCrossLink ? ReportCrossLink : ReportBadLink;
+		Report_Add(disk->report, type, finding->head, finding->cluster, finding->target);
+	}
+	Report_Flush(disk->report);
+	STATS_STOP(FATPhaseReport);
+}
+
+/* offset of the first byte at or after from where a and b differ, length if they are equal */
+static size_t FATImage_FindDifference(uint8_t* a, uint8_t* b, size_t from, size_t length)
+{
+	for( ; from + sizeof(uint64_t) <= length ; from += sizeof(uint64_t))
+	{
+		uint64_t wordA, wordB;
+		memcpy(&wordA, a + from, sizeof(uint64_t));
+		memcpy(&wordB, b + from, sizeof(uint64_t));
+		if(wordA != wordB)
+			break;
+	}
+	while(from < length && a[from] == b[from])
+		++from;
+	return from;
+}
+
+/* end of the run of differing bytes starting at from, a run ends at the first 8 equal bytes */
+static size_t FATImage_FindDifferenceEnd(uint8_t* a, uint8_t* b, size_t from, size_t length)
+{
+	size_t end = from + 1;
+	while(end < length && !(end + sizeof(uint64_t) <= length && memcmp(a + end, b + end, sizeof(uint64_t)) == 0))
+		++end;
+	while(a[end - 1] == b[end - 1])
+		--end;
+	return end;
+}
+
+static uint8_t* FATImage_FileAllocationTableCopy(FATImage* disk, size_t copy)
+{
+	return disk->table.base + copy * disk->information.fileAllocationTableSectorCount * disk->information.sectorSize;
+}
+
+void FATImage_AddCopyMismatch(FATImage* disk, size_t copy, size_t first, size_t end)
+{
+	assert(disk != NULL);
+
+	// FAT12 entries share bytes, so ranges of neighbouring byte runs can touch or overlap
+	if(disk->copyMismatchesLength > 0)
+	{
+		FATCopyMismatch* last = disk->copyMismatches + (disk->copyMismatchesLength - 1);
+		if(last->copy == copy && first <= last->end)
+		{
+			last->end = end > last->end ? end : last->end;
+			return;
+		}
+	}
+
+	if(disk->copyMismatchesLength >= disk->copyMismatchesCapacity)
+	{
+		size_t capacity = disk->copyMismatchesCapacity > 0 ? 2 * disk->copyMismatchesCapacity : 16;
+		disk->copyMismatches = Arena_Reallocate(disk->arena, disk->copyMismatches, disk->copyMismatchesCapacity * sizeof(FATCopyMismatch), capacity * sizeof(FATCopyMismatch));
+		disk->copyMismatchesCapacity = capacity;
+	}
+
+	FATCopyMismatch* mismatch = disk->copyMismatches + disk->copyMismatchesLength;
+	mismatch->copy = copy;
+	mismatch->first = first;
+	mismatch->end = end;
+	disk->copyMismatchesLength += 1;
+}
+
+size_t FATImage_CompareFileAllocationTableCopies(FATImage* disk)
+{
+	assert(disk != NULL);
+	assert(disk->table.base != NULL);
+	STATS_START();
+
+	size_t tableSize = disk->information.fileAllocationTableSectorCount * disk->information.sectorSize;
+	size_t bits = disk->table.type;
+	uint8_t* first = FATImage_FileAllocationTableCopy(disk, 0);
+
+	disk->copyMismatchesLength = 0;
+	for(size_t copy = 1 ; copy < disk->information.fileAllocationTableCopies ; ++copy)
+	{
+		uint8_t* other = FATImage_FileAllocationTableCopy(disk, copy);
+		size_t start = FATImage_FindDifference(first, other, 0, tableSize);
+		while(start < tableSize)
+		{
+			size_t end = FATImage_FindDifferenceEnd(first, other, start, tableSize);
+			size_t firstEntry = start * 8 / bits;
+			size_t endEntry = (end * 8 + bits - 1) / bits;
+			if(endEntry > disk->table.entryCount)
+				endEntry = disk->table.entryCount;
+			if(firstEntry < endEntry)
+			{
+				LOG(INFO, "FAT copy %zd differs in bytes %zd-%zd\n", copy + 1, start, end - 1);
+				FATImage_AddCopyMismatch(disk, copy, firstEntry, endEntry);
+			}
+			start = FATImage_FindDifference(first, other, end, tableSize);
+		}
+	}
+	STATS_STOP(FATPhaseCompare);
+	return disk->copyMismatchesLength;
+}
+
+void FATImage_PrintFileAllocationTableMismatches(FATImage* disk)
+{
+	assert(disk != NULL);
+	STATS_START();
+
+	for(size_t index = 0 ; index < disk->copyMismatchesLength ; ++index)
+	{
+		FATCopyMismatch* mismatch = disk->copyMismatches + index;
+		Report_Add(disk->report, ReportCopyMismatch, mismatch->copy + 1, mismatch->first, mismatch->end - 1);
+	}
+	Report_Flush(disk->report);
+	STATS_STOP(FATPhaseReport);
+}
+
+size_t FATImage_MirrorFileAllocationTable(FATImage* disk)
+{
+	assert(disk != NULL);
+	assert(disk->table.base != NULL);
+	STATS_START();
+
+	size_t tableSize = disk->information.fileAllocationTableSectorCount * disk->information.sectorSize;
+	uint8_t* first = FATImage_FileAllocationTableCopy(disk, 0);
+
+	size_t copied = 0;
+	for(size_t copy = 1 ; copy < disk->information.fileAllocationTableCopies ; ++copy)
+	{
+		uint8_t* other = FATImage_FileAllocationTableCopy(disk, copy);
+		size_t start = FATImage_FindDifference(first, other, 0, tableSize);
+		while(start < tableSize)
+		{
+			if(!FATImage_EnableRepairs(disk))
+			{
+				STATS_STOP(FATPhaseRepair);
+				return copied;
+			}
+			size_t end = FATImage_FindDifferenceEnd(first, other, start, tableSize);
+			memcpy(other + start, first + start, end - start);
+			FATImage_MarkDirty(disk, other + start, end - start);
+			copied += end - start;
+			start = FATImage_FindDifference(first, other, end, tableSize);
+		}
+	}
+
+	LOG(INFO, "mirrored %zd bytes of the file allocation table\n", copied);
+	disk->copyMismatchesLength = 0;
+	STATS_STOP(FATPhaseRepair);
+	return copied;
 }
 
 void FATImage_PrintUnreferencedClusters(FATImage* disk)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);
+	assert(disk->clusterStatuses != NULL);
+	STATS_START();
+
+	if(Bitset_CountAndNot(&(disk->fileClusters), &(disk->referencedClusters)) == 0)
+	{
+		STATS_STOP(FATPhaseReport);
+		return;
+	}
 
-	size_t unreferenced = 0;
 	for(size_t index = 0 ; index < disk->clusterChainsLength ; ++index)
 	{
 		ClusterChain* chain = disk->clusterChains + index;
 		if(chain->directoryEntry == NULL)
 		{
-			ClusterChainNode* node = chain->head;
-			while(node)
+			for(size_t extent = 0 ; extent < chain->extentsLength ; ++extent)
 			{
-				if(unreferenced == 0)
-					printf("Unreferenced:");
-				
-				unreferenced += 1;
-				printf(" %zd", node->index);
-				node = node->next;
+				size_t start = chain->extents[extent].start;
+				size_t end = start + chain->extents[extent].length;
+				for(size_t cluster = start ; cluster < end ; ++cluster)
+					Report_Add(disk->report, ReportUnreferenced, cluster, 0, 0);
 			}
 		}
 	}
-	if(unreferenced > 0)
-		putchar('\n');
+	Report_Flush(disk->report);
+	STATS_STOP(FATPhaseReport);
+}
+
+void FATImage_PrintUnreferencedClusterRanges(FATImage* disk)
+{
+	assert(disk != NULL);
+	assert(disk->clusterStatuses != NULL);
+	STATS_START();
+
+	Bitset* fileClusters = &(disk->fileClusters);
+	Bitset* referencedClusters = &(disk->referencedClusters);
+	size_t start = Bitset_NextAndNot(fileClusters, referencedClusters, 0);
+	if(start >= disk->clustersLength)
+	{
+		STATS_STOP(FATPhaseReport);
+		return;
+	}
+
+	while(start < disk->clustersLength)
+	{
+		size_t end = Bitset_RunEndAndNot(fileClusters, referencedClusters, start);
+		Report_Add(disk->report, ReportUnreferencedRange, start, end - 1, 0);
+		start = Bitset_NextAndNot(fileClusters, referencedClusters, end);
+	}
+	Report_Flush(disk->report);
+	STATS_STOP(FATPhaseReport);
 }
 
 void FATImage_PrintLostFiles(FATImage* disk)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);
+	assert(disk->clusterStatuses != NULL);
+	STATS_START();
 
 	for(size_t index = 0 ; index < disk->clusterChainsLength ; ++index)
 	{
 		ClusterChain* chain = disk->clusterChains + index;
 		if(chain->directoryEntry == NULL)
 		{
-			printf("Lost file: %zd %zd\n", chain->head->index, chain->length);
+			Report_Add(disk->report, ReportLostFile, ClusterChain_Head(chain), chain->length, 0);
 		}
 	}	
+	Report_Flush(disk->report);
+	STATS_STOP(FATPhaseReport);
 }
 
 DirectoryEntry* FATImage_WriteNewRootDirectoryEntry(FATImage* disk, char* filename, char* extension, size_t fileSize, size_t startCluster)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);
+	assert(disk->clusterStatuses != NULL);
 
 	uint8_t* lastRootDirectoryEntry = disk->lastRootDirectoryEntry;
 
@@ -425,21 +1669,38 @@ DirectoryEntry* FATImage_WriteNewRootDirectoryEntry(FATImage* disk, char* filena
 		if(index < strlen(extension))
 			lastRootDirectoryEntry[8 + index] = (uint8_t)extension[index];
 		else
-			lastRootDirectoryEntry[index] = ' ';
+			lastRootDirectoryEntry[8 + index] = ' ';
 	}
 
 	NumberTo8BitLittleEndianSequence(fileSize, lastRootDirectoryEntry + 28, 4);
-	NumberTo8BitLittleEndianSequence(startCluster, lastRootDirectoryEntry + 26, 2);
+	NumberTo8BitLittleEndianSequence(startCluster & 0xFFFF, lastRootDirectoryEntry + 26, 2);
+	if(disk->table.type == FAT32)
+		NumberTo8BitLittleEndianSequence(startCluster >> 16, lastRootDirectoryEntry + 20, 2);
 
 	DirectoryEntry* toReturn = FATImage_InitializeNewDirectoryEntry(disk, lastRootDirectoryEntry, 32);
-	if(INFO < log_level)
+	if(LOG_ENABLED(DETAIL))
 	{
-		printf("Wrote new root directory entry:\n");
-		DirectoryEntry_Print(toReturn);
+		fprintf(disk->output, "Wrote new root directory entry:\n");
+		DirectoryEntry_Print(toReturn, disk->output);
 	}
 
-	disk->lastRootDirectoryEntry = disk->lastRootDirectoryEntry + 32;
-	disk->lastRootDirectoryEntry[0] = 0x00;
+	// the next slot must still be in the root directory region (FAT12/FAT16) or in the same cluster of its chain (FAT32)
+	FATDiskInformation* info = &(disk->information);
+	size_t next = lastRootDirectoryEntry + 32 - disk->image;
+	bool full = disk->table.type == FAT32
+		? (next - info->dataSectorStartSector * info->sectorSize) % info->clusterSize == 0
+		: next >= (info->rootDirectoryStartSector + info->rootDirectorySectorCount) * info->sectorSize;
+	if(full)
+	{
+		disk->lastRootDirectoryEntry = NULL;
+		FATImage_MarkDirty(disk, lastRootDirectoryEntry, 32);
+	}
+	else
+	{
+		disk->lastRootDirectoryEntry = lastRootDirectoryEntry + 32;
+		disk->lastRootDirectoryEntry[0] = 0x00;
+		FATImage_MarkDirty(disk, lastRootDirectoryEntry, 33);
+	}
 
 	return toReturn;
 }
@@ -447,79 +1708,94 @@ DirectoryEntry* FATImage_WriteNewRootDirectoryEntry(FATImage* disk, char* filena
 void FATImage_RecoverLostFiles(FATImage* disk)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);
+	assert(disk->clusterStatuses != NULL);
+	STATS_START();
 
-	int lost = 0;
+	unsigned lost = 0;
 	for(size_t index = 0 ; index < disk->clusterChainsLength ; ++index)
 	{
 		ClusterChain* chain = disk->clusterChains + index;
 		if(chain->directoryEntry == NULL)
 		{
+			if(disk->lastRootDirectoryEntry == NULL)
+			{
+				Report_AddNamed(disk->report, ReportError, "root directory is full, lost files are not recovered", 0, 0);
+				Report_Flush(disk->report);
+				break;
+			}
+			if(!FATImage_EnableRepairs(disk))
+				break;
 			++lost;
 
-			char* filename = calloc(9, sizeof(char));
-			assert(filename != NULL);
-			sprintf(filename, "FOUND%d", lost);
-
-			char* extension = calloc(4, sizeof(char));
-			assert(extension != NULL);
-			strncpy(extension, "DAT", 3);
+			// only the first 8 characters end up in the directory entry
+			char filename[16];
+			snprintf(filename, sizeof(filename), "FOUND%u", lost);
 
-			size_t fileSize = chain->length * disk->information.sectorSize;
+			char extension[4] = "DAT";
 
-			DirectoryEntry* newEntry = FATImage_WriteNewRootDirectoryEntry(disk, filename, extension, fileSize, chain->head->index);
-			chain->directoryEntry = newEntry;
+			size_t fileSize = chain->length * disk->information.clusterSize;
 
-			free(filename);
-			free(extension);
+			DirectoryEntry* newEntry = FATImage_WriteNewRootDirectoryEntry(disk, filename, extension, fileSize, ClusterChain_Head(chain));
+			FATImage_LinkDirectoryEntry(disk, chain, newEntry);
 		}
 	}	
+	STATS_STOP(FATPhaseRepair);
 }
 
 void FATImage_PrintSizeInconsistencies(FATImage* disk)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);
+	assert(disk->clusterStatuses != NULL);
+	STATS_START();
 
-	size_t sectorSize = disk->information.sectorSize;
+	size_t clusterSize = disk->information.clusterSize;
 	for(size_t index = 0 ; index < disk->clusterChainsLength ; ++index)
 	{
 		ClusterChain* chain = disk->clusterChains + index;
-		if(!ClusterChain_SizeMatchesDirectoryEntry(chain, sectorSize))
+		if(!ClusterChain_SizeMatchesDirectoryEntry(chain, clusterSize))
 		{
 			DirectoryEntry* entry = chain->directoryEntry;
-			printf("%s.%s %zd %zd\n", entry->filename, entry->extension, entry->fileSize, chain->length * sectorSize);
+			char name[16];
+			snprintf(name, sizeof(name), "%s.%s", entry->filename, entry->extension);
+			Report_AddNamed(disk->report, ReportSizeInconsistency, name, entry->fileSize, chain->length * clusterSize);
 		}
 	}
+	Report_Flush(disk->report);
+	STATS_STOP(FATPhaseReport);
 }
 
 void FATImage_TruncateClusterChain(FATImage* disk, ClusterChain* chain, size_t newLength)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);
+	assert(disk->clusterStatuses != NULL);
 	assert(chain != NULL);
 	assert(newLength < chain->length);
 
 	LOG(INFO, 	"truncating %s.%s to %zd clusters = %zd bytes\n", chain->directoryEntry->filename, chain->directoryEntry->extension,
-				newLength, newLength * disk->information.sectorSize);
+				newLength, newLength * disk->information.clusterSize);
 
 	size_t traversed = 0;
-	ClusterChainNode* node = chain->head;
-	while(node)
+	for(size_t extent = 0 ; extent < chain->extentsLength ; ++extent)
 	{
-		traversed++;
-		if(traversed == newLength)
-		{
-			// mark cluster as last cluster of file
-			Write12BitLittleEndianSequence(0xFFF, disk->image + 512, node->index);
-		}
-		else if(traversed > newLength)
+		size_t start = chain->extents[extent].start;
+		size_t end = start + chain->extents[extent].length;
+		for(size_t cluster = start ; cluster < end ; ++cluster)
 		{
-			// mark cluster as free
-			Write12BitLittleEndianSequence(0x000, disk->image + 512, node->index);
+			traversed++;
+			if(traversed == newLength)
+			{
+				// mark cluster as last cluster of file
+				FATImage_WriteTableEntry(disk, cluster, disk->table.endOfChain);
+			}
+			else if(traversed > newLength)
+			{
+				// mark cluster as free
+				FATImage_WriteTableEntry(disk, cluster, 0x000);
+				disk->clusterChainIds[cluster] = 0;
+				Bitset_Clear(&(disk->fileClusters), cluster);
+				Bitset_Clear(&(disk->referencedClusters), cluster);
+			}
 		}
-		
-		node = node->next;
 	}
 
 	ClusterChain_Truncate(chain, newLength);
@@ -528,28 +1804,182 @@ void FATImage_TruncateClusterChain(FATImage* disk, ClusterChain* chain, size_t n
 void FATImage_ResolveSizeInconsistencies(FATImage* disk)
 {
 	assert(disk != NULL);
-	assert(disk->clusters != NULL);
+	assert(disk->clusterStatuses != NULL);
+	STATS_START();
 
-	size_t sectorSize = disk->information.sectorSize;
+	size_t clusterSize = disk->information.clusterSize;
 	for(size_t index = 0 ; index < disk->clusterChainsLength ; ++index)
 	{
 		ClusterChain* chain = disk->clusterChains + index;
-		if(!ClusterChain_SizeMatchesDirectoryEntry(chain, sectorSize))
+		if(!ClusterChain_SizeMatchesDirectoryEntry(chain, clusterSize))
 		{
-			size_t newLength = ceil(chain->directoryEntry->fileSize / 512.0);
+			size_t newLength = (chain->directoryEntry->fileSize + clusterSize - 1) / clusterSize;
 			if(newLength == 0)
 				newLength = 1;
 
 			if(newLength < chain->length)
+			{
+				if(!FATImage_EnableRepairs(disk))
+					break;
 				FATImage_TruncateClusterChain(disk, chain, newLength);
+			}
+		}
+	}
+	STATS_STOP(FATPhaseRepair);
+}
+
+bool FATImage_EnableRepairs(FATImage* disk)
+{
+	assert(disk != NULL);
+	if(disk->mode != FATImageReadOnly)
+		return true;
+
+	int fileDescriptor = open(disk->imagePath, O_RDWR);
+	if(fileDescriptor == -1)
+	{
+		FATImage_ReportSystemError(disk, "cannot repair image", errno);
+		return false;
+	}
+
+	// writes to the private mapping copy only the touched pages, the rest stay shared with the page cache
+	if(mprotect(disk->image, disk->imageSize, PROT_READ | PROT_WRITE) == -1)
+	{
+		FATImage_ReportSystemError(disk, "cannot repair image", errno);
+		close(fileDescriptor);
+		return false;
+	}
+	close(disk->imageFileDescriptor);
+	disk->imageFileDescriptor = fileDescriptor;
+	disk->mode = FATImageJournaled;
+	disk->journalPath = FATImage_JournalPath(disk->imagePath);
+	LOG(DETAIL, "reopened %s for repairs on fd %d\n", disk->imagePath, fileDescriptor);
+	return true;
+}
+
+JournalStatus FATImage_ApplyJournal(char* imageFile, bool undo)
+{
+	char* journalPath = FATImage_JournalPath(imageFile);
+
+	JournalStatus status = JournalMissing;
+	if(access(journalPath, F_OK) == 0)
+	{
+		int fileDescriptor = open(imageFile, O_RDWR);
+		if(fileDescriptor != -1)
+		{
+			status = Journal_Apply(journalPath, fileDescriptor, undo);
+			int currentError = errno;
+			close(fileDescriptor);
+			errno = currentError;
+		}
+		else
+			status = JournalFailed;
+	}
+
+	free(journalPath);
+	return status;
+}
+
+/* commits the merged dirty ranges of a private mapping through the sidecar journal */
+static size_t FATImage_CommitJournal(FATImage* disk)
+{
+	size_t ranges = FATImage_CoalesceDirtyPages(disk, 1);
+	if(ranges == 0)
+		return 0;
+
+	Journal* journal = Journal_Make();
+	bool journaled = true;
+	for(size_t index = 0 ; index < ranges && journaled ; ++index)
+	{
+		FATDirtyRange* range = disk->dirtyRanges + index;
+		journaled = Journal_Append(journal, disk->imageFileDescriptor, range->offset, disk->image + range->offset, range->length);
+	}
+
+	size_t written = 0;
+	if(journaled && Journal_Commit(journal, disk->journalPath, disk->imageFileDescriptor))
+		written = journal->bytesJournaled;
+	else
+	{
+		char context[256];
+		snprintf(context, sizeof(context), "error committing journal %s", disk->journalPath);
+		FATImage_ReportSystemError(disk, context, errno);
+	}
+
+	LOG(INFO, "committed %zd bytes in %zd ranges through %s\n", written, ranges, disk->journalPath);
+	Journal_Free(journal);
+	disk->dirtyRangesLength = 0;
+	return written;
+}
+
+/* writes the merged dirty ranges of a buffered image back to the file, never bytes that were not read from it,
+ * returns 0 if a write or the sync failed */
+static size_t FATImage_WriteBack(FATImage* disk)
+{
+	size_t written = 0;
+	size_t ranges = FATImage_CoalesceDirtyPages(disk, 1);
+	bool failed = false;
+	for(size_t index = 0 ; index < ranges && !failed ; ++index)
+	{
+		FATDirtyRange* range = disk->dirtyRanges + index;
+		for(size_t position = 0 ; position < range->length ; )
+		{
+			ssize_t count = pwrite(disk->imageFileDescriptor, disk->image + range->offset + position, range->length - position, range->offset + position);
+			if(count == -1 && errno == EINTR)
+				continue;
+			if(count <= 0)
+			{
+				FATImage_ReportSystemError(disk, "error writing image file", count == 0 ? EIO : errno);
+				failed = true;
+				break;
+			}
+			position += count;
 		}
+		written += range->length;
 	}
+	if(!failed && ranges > 0 && fsync(disk->imageFileDescriptor) == -1)
+	{
+		FATImage_ReportSystemError(disk, "error syncing image file", errno);
+		failed = true;
+	}
+
+	LOG(INFO, "wrote back %zd bytes in %zd ranges\n", failed ? 0 : written, ranges);
+	disk->dirtyRangesLength = 0;
+	return failed ? 0 : written;
 }
 
-void FATImage_SaveChanges(FATImage* disk)
+size_t FATImage_SaveChanges(FATImage* disk)
 {
 	assert(disk != NULL);
 	assert(disk->image != NULL);
+	STATS_START();
+
+	if(disk->mode == FATImageJournaled || disk->backend == FATImageBuffered)
+	{
+		size_t written = disk->mode == FATImageJournaled ? FATImage_CommitJournal(disk) : FATImage_WriteBack(disk);
+		STATS_ADD(bytesWritten, written);
+		STATS_STOP(FATPhaseSave);
+		return written;
+	}
+
+	long pageSize = sysconf(_SC_PAGESIZE);
+	size_t flushed = 0;
+	size_t ranges = FATImage_CoalesceDirtyPages(disk, pageSize > 0 ? pageSize : 4096);
+	for(size_t index = 0 ; index < ranges ; ++index)
+	{
+		// the last page of the image may be partially mapped
+		FATDirtyRange* range = disk->dirtyRanges + index;
+		size_t length = range->offset + range->length <= disk->imageSize ? range->length : disk->imageSize - range->offset;
+		if(msync(disk->image + range->offset, length, MS_SYNC) == -1)
+		{
+			FATImage_ReportSystemError(disk, "error syncing image file", errno);
+			flushed = 0;
+			break;
+		}
+		flushed += length;
+	}
 
-	msync(disk->image, disk->imageSize, MS_SYNC);
+	LOG(INFO, "flushed %zd bytes in %zd ranges\n", flushed, ranges);
+	disk->dirtyRangesLength = 0;
+	STATS_ADD(bytesSynced, flushed);
+	STATS_STOP(FATPhaseSave);
+	return flushed;
 }
\ No newline at end of file
@@ -1,19 +1,26 @@
 /** @file FATImage.h
  *	@author Bandi Enkh-Amgalan
- *  @brief Declaration of data structures and functions for reading, checking and repairing FAT12 floppy images
+ *  @brief Declaration of data structures and functions for reading, checking and repairing FAT12, FAT16 and FAT32 images
  *
- *	This function declares various structs for encapsulating the information parsed from a FAT12 floppy image,
+ *	This function declares various structs for encapsulating the information parsed from a FAT image,
  *  such as directory entries, cluster chains found in the file alocation talbe and boot sector information.
- *  It also provides various tools for checking and repairing FAT12 file system images. */
+ *  It also provides various tools for checking and repairing FAT file system images. The entry width
+ *  is detected from the boot sector, and all table access goes through FileAllocationTable. */
 
 #pragma once
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include "Arena.h"
+#include "Bitset.h"
 #include "ClusterChain.h"
 #include "DirectoryEntry.h"
+#include "FileAllocationTable.h"
+#include "Journal.h"
+#include "Report.h"
 
-/* FAT12 disk information (as parsed from boot sector) */
+/* FAT disk information (as parsed from boot sector) */
 typedef struct
 {
 	size_t sectorSize;
@@ -26,6 +33,9 @@ typedef struct
 	size_t rootDirectoryStartSector;
 	size_t dataSectorCount;
 	size_t dataSectorStartSector;
+	size_t clusterCount;
+	size_t clusterSize;
+	size_t rootDirectoryCluster;
 } FATDiskInformation;
 
 /* Cluster status (as parsed from file allocation table) */
@@ -40,33 +50,176 @@ typedef enum
 	MAX
 } ClusterStatus;
 
-/* Cluster information (parsed from file allocation table) */
+/* Summary of how the clusters in the data area are used */
 typedef struct
 {
-	ClusterChain* clusterChain;
-	uint16_t rawTableValue;
-	ClusterStatus status;
-} Cluster;
+	size_t clusters;
+	size_t free;
+	size_t reserved;
+	size_t bad;
+	size_t file;
+	size_t referenced;
+	size_t unreferenced;
+} FATClusterUsage;
 
-/* Encapsulation of a FAT12 floppy disk image, and any parsed clusters and directory entries */
+/* Kind of problem found while following cluster chains in the file allocation table */
+typedef enum
+{
+	ChainCycle,
+	ChainCrossLink,
+	ChainBadLink
+} ChainFindingType;
+
+/* Problem found while following a cluster chain: the link stored in cluster points to target, where
+ * target is already part of the same chain (cycle), part of another chain (cross-link), or out of range
+ * or a free, reserved or bad cluster (bad link) */
+typedef struct
+{
+	ChainFindingType type;
+	size_t head;
+	size_t cluster;
+	size_t target;
+} ChainFinding;
+
+/* Range of entries [first, end) where a copy of the file allocation table differs from the first copy */
+typedef struct
+{
+	size_t copy;
+	size_t first;
+	size_t end;
+} FATCopyMismatch;
+
+/* How an image file is opened and how repairs reach it */
+typedef enum
+{
+	FATImageShared,		/* image mapped shared, repairs go straight to the file and are synced by FATImage_SaveChanges() */
+	FATImageJournaled,	/* image mapped private, repairs stay in memory until FATImage_SaveChanges() commits them through a journal */
+	FATImageReadOnly	/* image opened read-only and mapped private without write access, see FATImage_EnableRepairs() */
+} FATImageMode;
+
+/* How the bytes of an image file reach memory */
+typedef enum
+{
+	FATImageMapped,		/* whole image file mapped, pages are faulted in by the kernel */
+	FATImageBuffered	/* only the regions FATImage_Access() is asked for are read with pread into an anonymous buffer */
+} FATImageBackend;
+
+/* Range of image bytes [offset, offset + length) modified since the last FATImage_SaveChanges() */
+typedef struct
+{
+	size_t offset;
+	size_t length;
+} FATDirtyRange;
+
+/* Part of a check timed by FATImageStats */
+typedef enum
+{
+	FATPhaseDiskInformation,	/* FATImage_UpdateDiskInformation() */
+	FATPhaseClassify,			/* decoding and classifying the file allocation table */
+	FATPhaseChains,				/* building cluster chains from the classified table */
+	FATPhaseDirectories,		/* FATImage_ReadDirectoryEntries(), including subdirectories */
+	FATPhaseCompare,			/* FATImage_CompareFileAllocationTableCopies() */
+	FATPhaseReport,				/* the Print functions */
+	FATPhaseRepair,				/* FATImage_RecoverLostFiles(), FATImage_ResolveSizeInconsistencies() and FATImage_MirrorFileAllocationTable() */
+	FATPhaseSave,				/* FATImage_SaveChanges() */
+	FATPhaseCount
+} FATImagePhase;
+
+/* Timers and counters of a FATImage, gathered only while enabled, see FATImage_EnableStats() */
 typedef struct
 {
-	Cluster* clusters;
+	bool enabled;
+
+	/* Monotonic time spent in each phase */
+	uint64_t phaseNanoseconds[FATPhaseCount];
+
+	size_t clustersClassified;
+	size_t chainsBuilt;
+	size_t extentsAllocated;		/* extents (the nodes of cluster chains) of the chains built */
+	size_t directoryEntriesParsed;
+	size_t bytesWritten;			/* written to the image file by a journal commit or a buffered write back */
+	size_t bytesSynced;				/* flushed from a shared mapping with msync */
+
+	/* Parse-time state allocated so far, filled in by FATImage_GetStats() */
+	size_t arenaBytes;
+	size_t arenaBlocks;
+} FATImageStats;
+
+/* Encapsulation of a FAT disk image, and any parsed clusters and directory entries */
+typedef struct
+{
+	/* Allocator for all parse-time state, released in one go by FATImage_Free() */
+	Arena* arena;
+
+	/* Number of threads decoding and classifying the file allocation table, see FATImage_SetWorkerCount() */
+	size_t workerCount;
+
+	/* Stream that reports, errors and log messages up to logLevel are printed to, see FATImage_SetOutput() */
+	FILE* output;
+	int logLevel;
+
+	/* Sink of the findings of the Print functions and of errors, written to output */
+	Report* report;
+
+	/* First file allocation table in the image, and the sentinel values of its type */
+	FileAllocationTable table;
+
+	/* Cluster information (parsed from file allocation table), stored as one column per field */
+	uint32_t* clusterValues;
+	uint8_t* clusterStatuses;
+	uint32_t* clusterChainIds;
 	size_t clustersLength;
+	size_t clusterStatusCounts[MAX];
+
+	/* Blocks of clusterValues decoded so far, lookups decode the value column lazily one block at a time */
+	Bitset decodedClusterBlocks;
+
+	/* Clusters that are part of any chain, and clusters in chains referenced by a directory entry */
+	Bitset fileClusters;
+	Bitset referencedClusters;
 
 	ClusterChain* clusterChains;
 	size_t clusterChainsLength;
 	size_t clusterChainsCapacity;
 
+	ChainFinding* chainFindings;
+	size_t chainFindingsLength;
+	size_t chainFindingsCapacity;
+
+	FATCopyMismatch* copyMismatches;
+	size_t copyMismatchesLength;
+	size_t copyMismatchesCapacity;
+
 	DirectoryEntry* directoryEntries;
 	size_t directoryEntriesLength;
 	size_t directoryEntriesCapacity;
+
+	/* Stands in for the directory entry of the FAT32 root directory cluster chain, which has none on disk */
+	DirectoryEntry rootDirectory;
 	
 	uint8_t* lastRootDirectoryEntry;
 
+	/* Modified ranges of the mapped image, flushed and cleared by FATImage_SaveChanges() */
+	FATDirtyRange* dirtyRanges;
+	size_t dirtyRangesLength;
+	size_t dirtyRangesCapacity;
+
 	uint8_t* image;
 	size_t imageSize;
 	int imageFileDescriptor; 
+
+	/* Sidecar journal file of a FATImageJournaled image, NULL otherwise */
+	FATImageMode mode;
+	char* imagePath;
+	char* journalPath;
+
+	/* Blocks of a FATImageBuffered image read from the file so far */
+	FATImageBackend backend;
+	Bitset loadedImageBlocks;
+	size_t bytesLoaded;
+
+	/* Per-phase timers and counters, see FATImage_EnableStats() */
+	FATImageStats stats;
 	FATDiskInformation information;
 } FATImage;
 
@@ -75,15 +228,67 @@ typedef struct
  *			This function will dynamically allocate a FATImage struct. Caller must free the FATImage
  *			struct by calling FATImage_Free(). Simply calling free() will cause memory leaks!
  *
- *			If any errors are encountered when reading and memory mapping the image file,
- *			the function will print out error information to stdout and return NULL.
+ *			If any errors are encountered when opening and memory mapping the image file, the file is closed
+ *			and the function returns NULL with errno set (an empty file cannot be mapped, errno is EINVAL).
  *			On successful initialization, caller should call FATImage_UpdateDiskInformation(),
  *			FATImage_ReadFileAllocationTable() and FATImage_ReadDirectoryEntries() in succession,
- *			before any file system check and repair operations. 
+ *			before any file system check and repair operations. The FAT type (12, 16 or 32) is
+ *			determined by FATImage_UpdateDiskInformation(). 
  *
  *  @return pointer to dynamically allocated FATImage struct on success, NULL otherwise */
 FATImage* FATImage_Initialize(char* imageFile);
 
+/** @brief	Initialize a FATImage struct with an image file, opened in the given mode and read through the given backend
+ *
+ *			Same as FATImage_Initialize(), which opens images in FATImageShared mode with the FATImageMapped backend.
+ *			In FATImageJournaled mode the image is mapped copy-on-write, so repairs never reach the file until
+ *			FATImage_SaveChanges() commits them through the sidecar journal file imageFile.journal.
+ *
+ *			The FATImageBuffered backend reserves an anonymous buffer the size of the image and only reads the boot
+ *			sector, the file allocation tables, the root directory and directory clusters into it, with pread.
+ *			Modified ranges are written back with pwrite. Every other function works the same on either backend.
+ *
+ *  @param 	imageFile
+ *  @param 	mode
+ *  @param 	backend
+ *  @return pointer to dynamically allocated FATImage struct on success, NULL otherwise */
+FATImage* FATImage_InitializeWithMode(char* imageFile, FATImageMode mode, FATImageBackend backend);
+
+/** @brief	Get a pointer to a range of the image, reading it from the file first if needed
+ *
+ *			With the FATImageMapped backend this is plain pointer arithmetic. With the FATImageBuffered backend
+ *			any 4096 byte blocks of the range that were not read yet are read with pread, one call per run of blocks.
+ *			Interrupted reads are retried, a failed or short read adds an error record to the report.
+ *
+ *  @param 	disk
+ *  @param 	offset	offset of the range in the image
+ *  @param 	length	length of the range in bytes
+ *  @return pointer to the range in disk->image, NULL if the range could not be read */
+uint8_t* FATImage_Access(FATImage* disk, size_t offset, size_t length);
+
+/** @brief	Make a FATImageReadOnly image writable, so it can be repaired
+ *
+ *			Reopens the image file for writing and gives the private mapping write access, switching the image
+ *			to FATImageJournaled mode. Pages already read stay shared with the page cache until they are written.
+ *			Does nothing for images in other modes. FATImage_RecoverLostFiles(), FATImage_ResolveSizeInconsistencies()
+ *			and FATImage_MirrorFileAllocationTable() call this before their first write, and skip their repairs
+ *			if it fails (e.g. on read-only media), after adding the error to the report.
+ *
+ *  @param 	disk
+ *  @return true if the image is writable, false otherwise */
+bool FATImage_EnableRepairs(FATImage* disk);
+
+/** @brief	Replay or roll back the sidecar journal file left behind by an interrupted FATImage_SaveChanges()
+ *
+ *			Replaying finishes the interrupted repairs, rolling back restores the image as it was before them.
+ *			A journal that was torn while being written is discarded, as the image was never touched.
+ *			If the journal could not be applied, errno is left set to the cause. 
+ *
+ *  @param 	imageFile
+ *  @param 	undo	roll back instead of replaying
+ *  @return outcome, see JournalStatus */
+JournalStatus FATImage_ApplyJournal(char* imageFile, bool undo);
+
 /** @brief	Free a dynamically allocated FATImage struct
  *
  *  @param disk */
@@ -93,9 +298,74 @@ void FATImage_Free(FATImage* disk);
  *
  *			This function loads essential information from the boot sector of the disk
  *			into the FATImage struct and must be called before file system checks and repair operations. 
+ *			The FAT type is derived from the data cluster count, as specified by the FAT file system
+ *			specification, and selects the entry width of FATImage::table. 
+ *
+ *			The boot sector is validated before anything else is read: the sector size, sectors per cluster and
+ *			table count must be usable, and the reserved sectors, tables, root directory and data area must all
+ *			lie inside the image, so a truncated or malformed image is rejected instead of read past its end.
+ *			Each problem is added to the report as an error record.
+ *
+ *  @param 	disk
+ *  @return true on success, false if the boot sector is invalid or the metadata could not be read */
+bool FATImage_UpdateDiskInformation(FATImage* disk);
+
+/** @brief	Set the stream reports and log messages are printed to, and the level of log messages
+ *
+ *			Every image has its own stream and level, so images checked on different threads never share
+ *			a stream or any global state. Defaults to stdout with logging off. 
+ *
+ *  @param 	disk
+ *  @param 	output		stream to print to
+ *  @param 	logLevel	0 for no log messages, 1 (info), 2 (detail) or 3 (debug) for increasingly verbose ones,
+ *  						capped by the LOG_LEVEL the library was compiled with */
+void FATImage_SetOutput(FATImage* disk, FILE* output, int logLevel);
+
+/** @brief	Set the encoding of findings printed by the Print functions and of errors
+ *
+ *			Findings are collected as typed records and written in one write per Print function call
+ *			(or per 1024 records). ReportText, the default, prints the lines documented with each Print function;
+ *			see Report.h for the ReportJSONLines and ReportBinary encodings. Log messages are always plain text.
+ *
+ *  @param 	disk
+ *  @param 	format */
+void FATImage_SetReportFormat(FATImage* disk, ReportFormat format);
+
+/** @brief	Set the number of threads used to decode and classify the file allocation table
+ *
+ *			FATImage_ReadFileAllocationTable() splits the table into one slab per worker, each decoded and
+ *			classified by its own thread, and merges the per-thread status counters afterwards. Slabs are
+ *			aligned to 4096 entries, so small tables use fewer workers. Defaults to 1 (no threads). 
+ *
+ *  @param 	disk
+ *  @param 	workerCount	number of workers, 0 for one worker per online CPU */
+void FATImage_SetWorkerCount(FATImage* disk, size_t workerCount);
+
+/** @brief	Start or stop gathering per-phase timers and counters
+ *
+ *			Stats are off by default. While off, every timer and counter costs one predictable branch; counters
+ *			are added once per phase rather than per cluster or entry, so enabling them costs two clock reads per phase. 
+ *
+ *  @param 	disk
+ *  @param 	enabled */
+void FATImage_EnableStats(FATImage* disk, bool enabled);
+
+/** @brief	Copy the timers and counters gathered so far, along with the current arena totals
+ *
+ *  @param 	disk
+ *  @param 	stats	destination */
+void FATImage_GetStats(FATImage* disk, FATImageStats* stats);
+
+/** @brief	Name of a phase, as used by FATImage_PrintStats()
+ *
+ *  @param 	phase
+ *  @return name of phase */
+const char* FATImage_PhaseName(FATImagePhase phase);
+
+/** @brief	Report the timers and counters gathered so far as statistic records, e.g. "Statistic: classify_ns 81234"
  *
  *  @param 	disk */
-void FATImage_UpdateDiskInformation(FATImage* disk);
+void FATImage_PrintStats(FATImage* disk);
 
 /** @brief	Read file allocation table and load information into FATImage struct
  *
@@ -109,6 +379,46 @@ void FATImage_UpdateDiskInformation(FATImage* disk);
  *  @param 	disk */
 void FATImage_ReadFileAllocationTable(FATImage* disk);
 
+/** @brief	Get the value stored in the file allocation table for a cluster (next cluster or end of chain marker)
+ *
+ *			Unlike FATImage_ReadFileAllocationTable(), this function does not decode the whole table. The block
+ *			of entries around the cluster is decoded from the mapped image the first time it is asked for and cached
+ *			in the cluster value column, so following a single chain only touches the parts of the table it uses.
+ *			A later FATImage_ReadFileAllocationTable() only decodes the blocks that are still missing. 
+ *
+ *			This function requires boot sector information to have been parsed with a call to
+ *			FATImage_UpdateDiskInformation(). 
+ *
+ *  @param 	disk
+ *  @param 	cluster	index of cluster, must be less than the number of data clusters + 2
+ *  @return file allocation table entry of cluster */
+uint32_t FATImage_GetNextCluster(FATImage* disk, size_t cluster);
+
+/** @brief	Follow a single cluster chain with lazily decoded table entries
+ *
+ *			Appends the clusters of the chain starting at start to chain, decoding only the table blocks
+ *			the chain passes through (see FATImage_GetNextCluster()). Following stops at the end of chain marker,
+ *			at a link outside the data area, at a link to a free, reserved or bad cluster and at a link back into the chain. 
+ *
+ *			This function requires boot sector information to have been parsed with a call to
+ *			FATImage_UpdateDiskInformation(). 
+ *
+ *  @param 	disk
+ *  @param 	start	first cluster of the chain, e.g. the start cluster of a directory entry
+ *  @param 	chain	chain to append clusters to
+ *  @return true if the chain ends with an end of chain marker, false otherwise */
+bool FATImage_ReadClusterChain(FATImage* disk, size_t start, ClusterChain* chain);
+
+/** @brief	Get the cluster chain (file) a cluster belongs to
+ *
+ *			Cluster chains are referenced by id in the cluster chain id column, where id 0 means
+ *			the cluster is not part of any chain and id n refers to clusterChains[n - 1]. 
+ *
+ *  @param 	disk
+ *  @param 	cluster	index of cluster
+ *  @return cluster chain the cluster belongs to, NULL if it does not belong to any chain */
+ClusterChain* FATImage_GetClusterChain(FATImage* disk, size_t cluster);
+
 /** @brief	Read all directory entries and load information into FATImage struct
  *
  *			This function requires boot sector information and file allocation table to have been
@@ -120,6 +430,81 @@ void FATImage_ReadFileAllocationTable(FATImage* disk);
  *  @param 	disk */
 void FATImage_ReadDirectoryEntries(FATImage* disk);
 
+/** @brief	Summarize cluster usage (free, reserved, bad, file, referenced and unreferenced clusters)
+ *
+ *			Counts come from per-status counters and popcounts over the file and referenced cluster bitsets,
+ *			so this function does not walk any cluster chains. 
+ *
+ *			This function requires boot sector information, file allocation table and directory entries
+ *			to have been parsed with calls to FATImage_UpdateDiskInformation(), FATImage_ReadFileAllocationTable()
+ *			and FATImage_ReadDirectoryEntries() functions. 
+ *
+ *  @param 	disk
+ *  @param 	usage	summary to fill in */
+void FATImage_GetClusterUsage(FATImage* disk, FATClusterUsage* usage);
+
+/** @brief	List indices of clusters that have not been referenced by any directory entries, in ascending order
+ *
+ *			This function sweeps the file and referenced cluster bitsets a word at a time. 
+ *
+ *			This function requires boot sector information, file allocation table and directory entries
+ *			to have been parsed with calls to FATImage_UpdateDiskInformation(), FATImage_ReadFileAllocationTable()
+ *			and FATImage_ReadDirectoryEntries() functions. 
+ *
+ *  @param 	disk
+ *  @param 	destination			array to store indices in
+ *  @param 	destinationLength	length of destination array
+ *  @return total number of unreferenced clusters, which may exceed destinationLength */
+size_t FATImage_GetUnreferencedClusters(FATImage* disk, size_t* destination, size_t destinationLength);
+
+/** @brief	Print (to stdout) cycles, cross-links and out of range links found in the file allocation table
+ *
+ *			Chains are followed with every cluster visited at most once, so corrupted tables cannot
+ *			stall parsing. A chain stops at the first link that loops back into itself, joins another chain,
+ *			points outside the data area or points at a cluster that is not part of any file, and the link is recorded
+ *			as a ChainFinding. 
+ *
+ *			This function requires boot sector information and file allocation table to have been
+ *			parsed with calls to FATImage_UpdateDiskInformation() and FATImage_ReadFileAllocationTable(). 
+ *			
+ *  @param 	disk */
+void FATImage_PrintChainFindings(FATImage* disk);
+
+/** @brief	Compare every copy of the file allocation table with the first copy
+ *
+ *			Copies are compared 8 bytes at a time, and every run of differing bytes is turned into the range of
+ *			entries it covers and recorded as a FATCopyMismatch (replacing the mismatches of any earlier call). 
+ *			Only the first copy is read and written by the other functions, so this finds copies that went
+ *			stale or were corrupted independently. 
+ *
+ *			This function requires boot sector information to have been parsed with a call to
+ *			FATImage_UpdateDiskInformation(). 
+ *
+ *  @param 	disk
+ *  @return number of mismatching entry ranges */
+size_t FATImage_CompareFileAllocationTableCopies(FATImage* disk);
+
+/** @brief	Print (to stdout) the mismatches found by FATImage_CompareFileAllocationTableCopies()
+ *
+ *			Prints one line per mismatch, e.g. "FAT copy 2 mismatch: 5-9" with 1-based copy numbers and
+ *			inclusive entry ranges. 
+ *
+ *  @param 	disk */
+void FATImage_PrintFileAllocationTableMismatches(FATImage* disk);
+
+/** @brief	Make every copy of the file allocation table identical to the first copy
+ *
+ *			Writes made by the repair functions only go to the first copy. This function mirrors them, and
+ *			repairs any other mismatch, in one batched pass: each copy is diffed 8 bytes at a time against
+ *			the first copy and only the differing runs of bytes are copied, so untouched pages stay clean. 
+ *
+ *			This function modifies the mapped image, but changes will not be flushed to disk until  
+ *			FATImage_SaveChanges() is called. 
+ *
+ *  @param 	disk
+ *  @return number of bytes copied */
+size_t FATImage_MirrorFileAllocationTable(FATImage* disk);
+
 /** @brief	Print (to stdout) indices of clusters that have not been referenced by any directory entries
  *
  *			This function requires boot sector information, file allocation table and directory entries
@@ -129,6 +514,19 @@ void FATImage_ReadDirectoryEntries(FATImage* disk);
  *  @param 	disk */
 void FATImage_PrintUnreferencedClusters(FATImage* disk);
 
+/** @brief	Print (to stdout) indices of clusters that have not been referenced by any directory entries, in ascending order
+ *
+ *			Unlike FATImage_PrintUnreferencedClusters(), clusters are printed sorted by index and consecutive
+ *			clusters are compressed into ranges, e.g. "Unreferenced: 7-10 20 30-31". The output is produced
+ *			by sweeping the file and referenced cluster bitsets, so it needs no sorting. 
+ *
+ *			This function requires boot sector information, file allocation table and directory entries
+ *			to have been parsed with calls to FATImage_UpdateDiskInformation(), FATImage_ReadFileAllocationTable()
+ *			and FATImage_ReadDirectoryEntries() functions. 
+ *			
+ *  @param 	disk */
+void FATImage_PrintUnreferencedClusterRanges(FATImage* disk);
+
 /** @brief	Print (to stdout) files/cluster chains that have not been referenced by any directory entries
  *
  *			This function requires boot sector information, file allocation table and directory entries
@@ -142,7 +540,7 @@ void FATImage_PrintLostFiles(FATImage* disk);
  *
  *			This function writes new root directory entries referencing each lost file. The lost files
  *			are named "FOUND1.DAT", "FOUND2.DAT" and so on. Each file is specified to have a size
- *			of sector_size (usually 512 bytes) * length of unreferenced cluster index chain. 
+ *			of cluster size (sector size * sectors per cluster) * length of unreferenced cluster index chain. 
  *
  *			This function modifies the mapped image, but changes will not be flushed to disk until  
  *			FATImage_SaveChanges() is called. 
@@ -181,6 +579,15 @@ void FATImage_ResolveSizeInconsistencies(FATImage* disk);
  *
  *			This function must be called after FATImage_ResolveSizeInconsistencies() and FATImage_RecoverLostFiles()
  *			for the writes to be flushed to disk. 
+ *
+ *			Every write to the mapped image records the range it modified. This function rounds the ranges out
+ *			to whole pages, coalesces them and only syncs those pages, instead of the whole image. 
+ *
+ *			In FATImageJournaled mode the modified ranges are merged and committed through the sidecar journal file
+ *			instead: the journal is written and synced, then the ranges are written to the image and synced,
+ *			then the journal is removed. Errors writing the journal are added to the report and leave the image untouched. 
+ *			A failed write, sync or msync is added to the report as an error record, and nothing is counted as saved.
  *			
- *  @param 	disk */
-void FATImage_SaveChanges(FATImage* disk);
\ No newline at end of file
+ *  @param 	disk
+ *  @return number of bytes flushed (whole pages, or the merged ranges in FATImageJournaled mode), 0 on error */
+size_t FATImage_SaveChanges(FATImage* disk);
\ No newline at end of file
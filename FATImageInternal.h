@@ -0,0 +1,33 @@
+/** @file FATImageInternal.h
+ *	@author Bandi Enkh-Amgalan
+ *  @brief Declaration of the FATImage functions behind FATImage_ReadFileAllocationTable(), for tests and benchmarks
+ *
+ *  These functions let a caller build a FATImage around a table in memory and run one step of the table parse
+ *  on its own. Programs checking images should only need FATImage.h. */
+
+#pragma once
+
+#include "FATImage.h"
+
+/** @brief	Allocate a FATImage struct with no image, empty chain and directory entry arrays and its own arena
+ *
+ *  @return pointer to dynamically allocated FATImage struct, to be freed with FATImage_Free() */
+FATImage* FATImage_Make();
+
+/** @brief	Allocate the value, status and chain id columns of length clusters (two reserved entries included)
+ *			and the bitsets over them in the arena of disk
+ *
+ *  @param 	disk
+ *  @param 	length */
+void FATImage_AllocateClusters(FATImage* disk, size_t length);
+
+/** @brief	Decode every table entry into the value column and classify it into the status column, on the worker threads
+ *
+ *  @param 	disk	with clusters allocated by FATImage_AllocateClusters() */
+void FATImage_DecodeAndClassifyClusters(FATImage* disk);
+
+/** @brief	Decode and classify the table, then build a cluster chain for each file in it and record the cycles,
+ *			cross-links and bad links found on the way
+ *
+ *  @param 	disk	with clusters allocated by FATImage_AllocateClusters() */
+void FATImage_ReadClusterIndexSequenceAndCreateFileChains(FATImage* disk);
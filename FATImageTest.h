@@ -1,13 +1,15 @@
 #include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
 #include "greatest/greatest.h"
-#include "FATImage.h"
-
-FATImage* FATImage_Make();
+#include "FATImageInternal.h"
 
 TEST FATImage_Make_ReturnsZeroedOutStructWithZeroedOutFileChains()
 {
 	FATImage* disk = FATImage_Make();
-	ASSERT_EQ(disk->clusters, NULL);
+	ASSERT_EQ(disk->clusterValues, NULL);
+	ASSERT_EQ(disk->clusterStatuses, NULL);
+	ASSERT_EQ(disk->clusterChainIds, NULL);
 	ASSERT_EQ(disk->clustersLength, 0);
 	ASSERT_EQ(disk->image, NULL);
 	ASSERT_EQ(disk->imageSize, 0);
@@ -20,8 +22,8 @@ TEST FATImage_Make_ReturnsZeroedOutStructWithZeroedOutFileChains()
 		for(size_t index = 0 ; index < disk->clusterChainsCapacity ; ++index)
 		{
 			ClusterChain* chain = disk->clusterChains + index;
-			ASSERT_EQ(chain->head, NULL);
-			ASSERT_EQ(chain->tail, NULL);
+			ASSERT_EQ(chain->extents, NULL);
+			ASSERT_EQ(chain->extentsLength, 0);
 			ASSERT_EQ(chain->length, 0);
 		}
 	} else {
@@ -35,8 +37,8 @@ TEST FATImage_Make_ReturnsZeroedOutStructWithZeroedOutFileChains()
 		{
 			DirectoryEntry* entry = disk->directoryEntries + index;
 			ASSERT_EQ(entry->parent, NULL);
-			ASSERT_EQ(entry->filename, NULL);
-			ASSERT_EQ(entry->extension, NULL);
+			ASSERT_STR_EQ(entry->filename, "");
+			ASSERT_STR_EQ(entry->extension, "");
 			ASSERT_EQ(entry->attributes, 0);
 			ASSERT_EQ(entry->fileSize, 0);
 			ASSERT_EQ(entry->startCluster, 0);
@@ -59,10 +61,83 @@ TEST FATImage_Initialize_ReturnsStructWithImageFileInfo()
 	PASS();
 }
 
+TEST FATImage_InitializeWithMode_ReadOnlyBecomesWritableOnRepair()
+{
+	FATImage* disk = FATImage_InitializeWithMode("images/floppy.img", FATImageReadOnly, FATImageMapped);
+	ASSERT_EQ(disk->mode, FATImageReadOnly);
+	ASSERT_EQ(disk->journalPath, NULL);
+
+	// the mapping is private, so the write below never reaches the image file
+	ASSERT(FATImage_EnableRepairs(disk));
+	ASSERT_EQ(disk->mode, FATImageJournaled);
+	ASSERT_STR_EQ(disk->journalPath, "images/floppy.img.journal");
+	disk->image[0] ^= 0xFF;
+	ASSERT(FATImage_EnableRepairs(disk));
+
+	FATImage_Free(disk);
+	disk = FATImage_InitializeWithMode("images/floppy.img", FATImageReadOnly, FATImageMapped);
+	ASSERT_EQ(disk->image[0], 0xEB);
+	FATImage_Free(disk);
+	PASS();
+}
+
+TEST FATImage_InitializeWithMode_BufferedBackendReadsOnlyMetadata()
+{
+	FATImage* disks[2];
+	disks[0] = FATImage_InitializeWithMode("images/floppy.img", FATImageReadOnly, FATImageMapped);
+	disks[1] = FATImage_InitializeWithMode("images/floppy.img", FATImageReadOnly, FATImageBuffered);
+	for(size_t index = 0 ; index < 2 ; ++index)
+	{
+		ASSERT(FATImage_UpdateDiskInformation(disks[index]));
+		FATImage_ReadFileAllocationTable(disks[index]);
+		FATImage_ReadDirectoryEntries(disks[index]);
+	}
+
+	// boot sector, both tables and the root directory end at byte 16896, directories add a few blocks
+	ASSERT_EQ(disks[0]->bytesLoaded, 0);
+	ASSERT(disks[1]->bytesLoaded >= 16896);
+	ASSERT(disks[1]->bytesLoaded < disks[1]->imageSize / 10);
+	ASSERT_EQ(disks[1]->information.clusterCount, disks[0]->information.clusterCount);
+	ASSERT_EQ(memcmp(disks[1]->table.base, disks[0]->table.base, 9 * 512), 0);
+	ASSERT_EQ(disks[1]->clusterChainsLength, disks[0]->clusterChainsLength);
+	ASSERT_EQ(disks[1]->directoryEntriesLength, disks[0]->directoryEntriesLength);
+	for(size_t index = 0 ; index < disks[0]->directoryEntriesLength ; ++index)
+	{
+		ASSERT_STR_EQ(disks[1]->directoryEntries[index].filename, disks[0]->directoryEntries[index].filename);
+		ASSERT_EQ(disks[1]->directoryEntries[index].startCluster, disks[0]->directoryEntries[index].startCluster);
+	}
+
+	FATImage_Free(disks[0]);
+	FATImage_Free(disks[1]);
+	PASS();
+}
+
+TEST FATImage_Access_ReportsFailedReads()
+{
+	FATImage* disk = FATImage_InitializeWithMode("images/floppy.img", FATImageReadOnly, FATImageBuffered);
+	FILE* output = tmpfile();
+	FATImage_SetOutput(disk, output, 0);
+
+	// every read of a closed descriptor fails, nothing is counted as loaded
+	close(disk->imageFileDescriptor);
+	disk->imageFileDescriptor = -1;
+	ASSERT_EQ(FATImage_Access(disk, 0, 512), NULL);
+	ASSERT_FALSE(FATImage_UpdateDiskInformation(disk));
+	ASSERT_EQ(disk->bytesLoaded, 0);
+	FATImage_Free(disk);
+
+	char buffer[256] = { 0 };
+	rewind(output);
+	ASSERT(fread(buffer, 1, sizeof(buffer) - 1, output) > 0);
+	ASSERT(strstr(buffer, "dos_scandisk: error reading image file: ") == buffer);
+	fclose(output);
+	PASS();
+}
+
 TEST FATImage_UpdateDiskInformation_Success()
 {
 	FATImage* disk = FATImage_Initialize("images/floppy.img");
-	FATImage_UpdateDiskInformation(disk);
+	ASSERT(FATImage_UpdateDiskInformation(disk));
 	ASSERT_EQ(disk->information.sectorSize, 512);
 	ASSERT_EQ(disk->information.sectorCount, 2880);
 	ASSERT_EQ(disk->information.sectorsPerCluster, 1);
@@ -81,6 +156,49 @@ TEST FATImage_UpdateDiskInformation_Success()
 	PASS();
 }
 
+TEST FATImage_UpdateDiskInformation_RejectsMalformedBootSectors()
+{
+	FATImage* disk = FATImage_Make();
+	uint8_t image[8 * 512] = { 0 };
+	disk->image = image;
+	disk->imageSize = sizeof(image);
+	FILE* output = tmpfile();
+	FATImage_SetOutput(disk, output, 0);
+
+	// an all zero boot sector has no sector size
+	ASSERT_FALSE(FATImage_UpdateDiskInformation(disk));
+
+	// 512 byte sectors, one reserved sector, two one-sector tables and one root directory sector, of 2880 sectors
+	uint8_t bootSector[] = { 0x00, 0x02, 0x01, 0x01, 0x00, 0x02, 0x10, 0x00, 0x40, 0x0B, 0xF0, 0x01, 0x00 };
+	memcpy(image + 11, bootSector, sizeof(bootSector));
+	ASSERT_FALSE(FATImage_UpdateDiskInformation(disk));
+
+	// the same layout ending with the image is accepted
+	image[19] = 8;
+	image[20] = 0;
+	ASSERT(FATImage_UpdateDiskInformation(disk));
+	ASSERT_EQ(disk->information.dataSectorStartSector, 4);
+	ASSERT_EQ(disk->information.clusterCount, 4);
+
+	disk->imageSize = 100;
+	ASSERT_FALSE(FATImage_UpdateDiskInformation(disk));
+
+	disk->image = NULL;
+	disk->imageSize = 0;
+	disk->imageFileDescriptor = -1;
+	FATImage_Free(disk);
+
+	char buffer[512] = { 0 };
+	rewind(output);
+	ASSERT(fread(buffer, 1, sizeof(buffer) - 1, output) > 0);
+	ASSERT_STR_EQ(buffer,
+		"dos_scandisk: invalid boot sector: sector size is not 512, 1024, 2048 or 4096 bytes\n"
+		"dos_scandisk: invalid boot sector: image is shorter than its sector count\n"
+		"dos_scandisk: invalid boot sector: image is smaller than a boot sector\n");
+	fclose(output);
+	PASS();
+}
+
 ClusterChain* FATImage_GetNewFileChain(FATImage* disk);
 
 TEST FATImage_GetNewFileChain_ReturnsNewItemAndUpdatesLength()
@@ -99,11 +217,11 @@ TEST FATImage_GetNewFileChain_ReturnsNewItemAndUpdatesLength()
 
 	// Check if two new/distinct items were actually returned
 	ASSERT_EQ(one->length, 1);
-	ASSERT_EQ(one->head->index, 42);
+	ASSERT_EQ(ClusterChain_Head(one), 42);
 
 	ASSERT_EQ(two->length, 2);
-	ASSERT_EQ(two->head->index, 24);
-	ASSERT_EQ(two->head->next->index, 42);
+	ASSERT_EQ(ClusterChain_Head(two), 24);
+	ASSERT_EQ(ClusterChain_IndexAt(two, 1), 42);
 
 	FATImage_Free(disk);
 	PASS();
@@ -132,14 +250,14 @@ TEST FATImage_GetNewFileChain_GrowsArrayAsNeeded()
 	{
 		ClusterChain* chain = disk->clusterChains + index;
 		ASSERT_EQ(chain->length, 1);
-		ASSERT_EQ(chain->head->index, index);
+		ASSERT_EQ(ClusterChain_Head(chain), index);
 	}
 
 	for(size_t index = disk->clusterChainsLength ; index < disk->clusterChainsCapacity ; ++index)
 	{
 		ClusterChain* chain = disk->clusterChains + index;
-		ASSERT_EQ(chain->head, NULL);
-		ASSERT_EQ(chain->tail, NULL);
+		ASSERT_EQ(chain->extents, NULL);
+		ASSERT_EQ(chain->extentsLength, 0);
 		ASSERT_EQ(chain->length, 0);
 	}
 
@@ -154,10 +272,10 @@ TEST FATImage_GetNewDirectoryEntry_ReturnsNewItemAndUpdatesLength()
 	FATImage* disk = FATImage_Make();
 
 	DirectoryEntry* one = FATImage_GetNewDirectoryEntry(disk);
-	one->filename = "one";
+	strcpy(one->filename, "one");
 
 	DirectoryEntry* two = FATImage_GetNewDirectoryEntry(disk);
-	two->filename = "two";
+	strcpy(two->filename, "two");
 
 	// Check length is updated
 	ASSERT_EQ(disk->directoryEntriesLength, 2);
@@ -166,10 +284,6 @@ TEST FATImage_GetNewDirectoryEntry_ReturnsNewItemAndUpdatesLength()
 	ASSERT_STR_EQ(one->filename, "one");
 	ASSERT_STR_EQ(two->filename, "two");
 
-	// set to NULL to prevent bad free() call
-	one->filename = NULL;
-	two->filename = NULL;
-
 	FATImage_Free(disk);
 	PASS();
 }
@@ -202,8 +316,8 @@ TEST FATImage_GetNewDirectoryEntry_GrowsArrayAsNeeded()
 	{
 		DirectoryEntry* entry = disk->directoryEntries + index;
 		ASSERT_EQ(entry->parent, NULL);
-		ASSERT_EQ(entry->filename, NULL);
-		ASSERT_EQ(entry->extension, NULL);
+		ASSERT_STR_EQ(entry->filename, "");
+		ASSERT_STR_EQ(entry->extension, "");
 		ASSERT_EQ(entry->attributes, 0);
 		ASSERT_EQ(entry->fileSize, 0);
 		ASSERT_EQ(entry->startCluster, 0);
@@ -213,32 +327,77 @@ TEST FATImage_GetNewDirectoryEntry_GrowsArrayAsNeeded()
 	PASS();
 }
 
-void CopyTableValuesToClusterArray(Cluster* clusters, uint16_t* values, size_t length)
+TEST FATImage_GetNewDirectoryEntry_GrowingKeepsReferencesValid()
 {
+	FATImage* disk = FATImage_Make();
+
+	DirectoryEntry* parent = FATImage_GetNewDirectoryEntry(disk);
+	strcpy(parent->filename, "PARENT");
+	DirectoryEntry* child = FATImage_GetNewDirectoryEntry(disk);
+	child->parent = parent;
+	ClusterChain* chain = FATImage_GetNewFileChain(disk);
+	chain->directoryEntry = child;
+
+	size_t capacity = disk->directoryEntriesCapacity;
+	while(disk->directoryEntriesLength <= capacity)
+		FATImage_GetNewDirectoryEntry(disk);
+
+	ASSERT_EQ(chain->directoryEntry, disk->directoryEntries + 1);
+	ASSERT_EQ(disk->directoryEntries[1].parent, disk->directoryEntries);
+	ASSERT_STR_EQ(chain->directoryEntry->parent->filename, "PARENT");
+
+	FATImage_Free(disk);
+	PASS();
+}
+
+void FATImage_ParseDirectoryEntry(uint8_t* directoryEntry, size_t directoryEntrySize, DirectoryEntry* entry);
+
+TEST FATImage_ParseDirectoryEntry_StoresNamesInline()
+{
+	uint8_t raw[32] = "FOUND1  DAT";
+	raw[11] = 0x20;
+	raw[26] = 0x2A;
+	raw[28] = 0x00; raw[29] = 0x02;
+
+	DirectoryEntry entry = { 0 };
+	FATImage_ParseDirectoryEntry(raw, 32, &entry);
+	ASSERT_STR_EQ(entry.filename, "FOUND1");
+	ASSERT_STR_EQ(entry.extension, "DAT");
+	ASSERT(DirectoryEntry_HasName(&entry, "FOUND1  DAT"));
+	ASSERT_FALSE(DirectoryEntry_HasName(&entry, "FOUND2  DAT"));
+	ASSERT_EQ(entry.attributes, 0x20);
+	ASSERT_EQ(entry.startCluster, 42);
+	ASSERT_EQ(entry.fileSize, 512);
+	PASS();
+}
+
+
+void CopyTableValuesToClusterArray(FATImage* disk, uint16_t* values, size_t length)
+{
+	FATImage_AllocateClusters(disk, length);
 	for(size_t index = 0 ; index < length ; ++index)
-		clusters[index].rawTableValue = values[index];
+		disk->clusterValues[index] = values[index];
+	Bitset_SetRange(&(disk->decodedClusterBlocks), 0, disk->decodedClusterBlocks.length);
 }
 
-void FATImage_ReadClusterIndexSequenceAndCreateFileChains(FATImage* disk);
 
 TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_UnusedBadReserved()
 {
 	FATImage* disk = FATImage_Make();
-	disk->clusters = calloc(7, sizeof(Cluster)); disk->clustersLength = 7;
-	CopyTableValuesToClusterArray(disk->clusters, (uint16_t[]){ 0x000, 0x000, 0x000, 0xFF0, 0xFF3, 0xFF6, 0xFF7}, 7);
+	CopyTableValuesToClusterArray(disk, (uint16_t[]){ 0x000, 0x000, 0x000, 0xFF0, 0xFF3, 0xFF6, 0xFF7}, 7);
 	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
 
 	ASSERT_EQ(disk->clusterChainsLength, 0);
 	for(size_t index = 2 ; index < 6 ; ++index)
 	{
-		ASSERT_EQ(disk->clusters[index].clusterChain, NULL);
+		ASSERT_EQ(FATImage_GetClusterChain(disk, index), NULL);
 	}
 
-	ASSERT_EQ(disk->clusters[2].status, Unused);
-	ASSERT_EQ(disk->clusters[3].status, Reserved);
-	ASSERT_EQ(disk->clusters[4].status, Reserved);
-	ASSERT_EQ(disk->clusters[5].status, Reserved);
-	ASSERT_EQ(disk->clusters[6].status, Bad);
+	ASSERT_EQ(disk->clusterStatuses[2], Unused);
+	ASSERT_EQ(disk->clusterStatuses[3], Reserved);
+	ASSERT_EQ(disk->clusterStatuses[4], Reserved);
+	ASSERT_EQ(disk->clusterStatuses[5], Reserved);
+	ASSERT_EQ(disk->clusterStatuses[6], Bad);
 
 	FATImage_Free(disk);
 	PASS();
@@ -247,16 +406,15 @@ TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_UnusedBadReserved()
 TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_FourSeparateFiles()
 {
 	FATImage* disk = FATImage_Make();
-	disk->clusters = calloc(6, sizeof(Cluster)); disk->clustersLength = 6;
-	CopyTableValuesToClusterArray(disk->clusters, (uint16_t[]){ 0x000, 0x000, 0xFF8, 0xFFB, 0xFFC, 0xFFF}, 6);
+	CopyTableValuesToClusterArray(disk, (uint16_t[]){ 0x000, 0x000, 0xFF8, 0xFFB, 0xFFC, 0xFFF}, 6);
 	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
 
 	ASSERT_EQ(disk->clusterChainsLength, 4);
 	for(size_t index = 2 ; index < 6 ; ++index)
 	{
-		ASSERT_EQ(disk->clusters[index].clusterChain->length, 1);
-		ASSERT_EQ(disk->clusters[index].clusterChain->head->index, index);
-		ASSERT_EQ(disk->clusters[index].status, FileLast);
+		ASSERT_EQ(FATImage_GetClusterChain(disk, index)->length, 1);
+		ASSERT_EQ(ClusterChain_Head(FATImage_GetClusterChain(disk, index)), index);
+		ASSERT_EQ(disk->clusterStatuses[index], FileLast);
 	}
 
 	FATImage_Free(disk);
@@ -266,21 +424,21 @@ TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_FourSeparateFiles()
 TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_OneBigFile()
 {
 	FATImage* disk = FATImage_Make();
-	disk->clusters = calloc(6, sizeof(Cluster)); disk->clustersLength = 6; disk->information.dataSectorCount = 4;
-	CopyTableValuesToClusterArray(disk->clusters, (uint16_t[]){ 0x000, 0x000, 0x003, 0x004, 0x005, 0xFFF}, 6);
+	disk->information.dataSectorCount = 4;
+	CopyTableValuesToClusterArray(disk, (uint16_t[]){ 0x000, 0x000, 0x003, 0x004, 0x005, 0xFFF}, 6);
 	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
 
 	ClusterChain* chain = disk->clusterChains;
 	ASSERT_EQ(disk->clusterChainsLength, 1);
 	ASSERT_EQ(chain->length, 4);
-	ASSERT_EQ(chain->head->index, 2);
-	ASSERT_EQ(chain->head->next->index, 3);
-	ASSERT_EQ(chain->head->next->next->index, 4);
-	ASSERT_EQ(chain->tail->index, 5);
+	ASSERT_EQ(ClusterChain_Head(chain), 2);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 1), 3);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 2), 4);
+	ASSERT_EQ(ClusterChain_Tail(chain), 5);
 	for(size_t index = 2 ; index < 6 ; ++index)
 	{
-		ASSERT_EQ(disk->clusters[index].clusterChain, chain);
-		ASSERT_EQ(disk->clusters[index].status, index == 5 ? FileLast : File);
+		ASSERT_EQ(FATImage_GetClusterChain(disk, index), chain);
+		ASSERT_EQ(disk->clusterStatuses[index], index == 5 ? FileLast : File);
 	}
 
 	FATImage_Free(disk);
@@ -290,47 +448,549 @@ TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_OneBigFile()
 TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_ThreeFragmentedFiles()
 {
 	FATImage* disk = FATImage_Make();
-	disk->clusters = calloc(8, sizeof(Cluster)); disk->clustersLength = 8; disk->information.dataSectorCount = 6;
-	CopyTableValuesToClusterArray(disk->clusters, (uint16_t[]){ 0x000, 0x000, 0x004, 0x005, 0xFFF, 0x006, 0xFFF, 0xFFF }, 8);
+	disk->information.dataSectorCount = 6;
+	CopyTableValuesToClusterArray(disk, (uint16_t[]){ 0x000, 0x000, 0x004, 0x005, 0xFFF, 0x006, 0xFFF, 0xFFF }, 8);
 	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
 
 	ASSERT_EQ(disk->clusterChainsLength, 3);
 	ClusterChain* one = disk->clusterChains;
 	ASSERT_EQ(one->length, 2);
-	ASSERT_EQ(one->head->index, 2);
-	ASSERT_EQ(one->tail->index, 4);
-	ASSERT_EQ(disk->clusters[2].status, File); ASSERT_EQ(disk->clusters[2].clusterChain, one);
-	ASSERT_EQ(disk->clusters[4].status, FileLast); ASSERT_EQ(disk->clusters[4].clusterChain, one);
+	ASSERT_EQ(ClusterChain_Head(one), 2);
+	ASSERT_EQ(ClusterChain_Tail(one), 4);
+	ASSERT_EQ(disk->clusterStatuses[2], File); ASSERT_EQ(FATImage_GetClusterChain(disk, 2), one);
+	ASSERT_EQ(disk->clusterStatuses[4], FileLast); ASSERT_EQ(FATImage_GetClusterChain(disk, 4), one);
 
 	ClusterChain* two = disk->clusterChains + 1;
 	ASSERT_EQ(two->length, 3);
-	ASSERT_EQ(two->head->index, 3);
-	ASSERT_EQ(two->head->next->index, 5);
-	ASSERT_EQ(two->tail->index, 6);
-	ASSERT_EQ(disk->clusters[3].status, File); ASSERT_EQ(disk->clusters[3].clusterChain, two);
-	ASSERT_EQ(disk->clusters[5].status, File); ASSERT_EQ(disk->clusters[5].clusterChain, two);
-	ASSERT_EQ(disk->clusters[6].status, FileLast); ASSERT_EQ(disk->clusters[6].clusterChain, two);
+	ASSERT_EQ(ClusterChain_Head(two), 3);
+	ASSERT_EQ(ClusterChain_IndexAt(two, 1), 5);
+	ASSERT_EQ(ClusterChain_Tail(two), 6);
+	ASSERT_EQ(disk->clusterStatuses[3], File); ASSERT_EQ(FATImage_GetClusterChain(disk, 3), two);
+	ASSERT_EQ(disk->clusterStatuses[5], File); ASSERT_EQ(FATImage_GetClusterChain(disk, 5), two);
+	ASSERT_EQ(disk->clusterStatuses[6], FileLast); ASSERT_EQ(FATImage_GetClusterChain(disk, 6), two);
 
 	ClusterChain* three = disk->clusterChains + 2;
 	ASSERT_EQ(three->length, 1);
-	ASSERT_EQ(three->head->index, 7);
-	ASSERT_EQ(disk->clusters[7].status, FileLast); ASSERT_EQ(disk->clusters[7].clusterChain, three);
+	ASSERT_EQ(ClusterChain_Head(three), 7);
+	ASSERT_EQ(disk->clusterStatuses[7], FileLast); ASSERT_EQ(FATImage_GetClusterChain(disk, 7), three);
+
+	FATImage_Free(disk);
+	PASS();
+}
+
+TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_HeadAfterMiddle()
+{
+	FATImage* disk = FATImage_Make();
+	disk->information.dataSectorCount = 5;
+	CopyTableValuesToClusterArray(disk, (uint16_t[]){ 0x000, 0x000, 0xFFF, 0x002, 0x003, 0x006, 0xFFF }, 7);
+	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
+
+	ASSERT_EQ(disk->clusterChainsLength, 2);
+	ClusterChain* one = disk->clusterChains;
+	ASSERT_EQ(one->length, 3);
+	ASSERT_EQ(ClusterChain_Head(one), 4);
+	ASSERT_EQ(ClusterChain_IndexAt(one, 1), 3);
+	ASSERT_EQ(ClusterChain_Tail(one), 2);
+	ASSERT_EQ(disk->clusterStatuses[2], FileLast); ASSERT_EQ(FATImage_GetClusterChain(disk, 2), one);
+	ASSERT_EQ(disk->clusterStatuses[4], File); ASSERT_EQ(FATImage_GetClusterChain(disk, 4), one);
+
+	ClusterChain* two = disk->clusterChains + 1;
+	ASSERT_EQ(two->length, 2);
+	ASSERT_EQ(ClusterChain_Head(two), 5);
+	ASSERT_EQ(ClusterChain_Tail(two), 6);
+
+	FATImage_Free(disk);
+	PASS();
+}
+
+TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_HeadlessCycle()
+{
+	FATImage* disk = FATImage_Make();
+	disk->information.dataSectorCount = 3;
+	CopyTableValuesToClusterArray(disk, (uint16_t[]){ 0x000, 0x000, 0x004, 0x002, 0x003 }, 5);
+	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
+
+	ASSERT_EQ(disk->clusterChainsLength, 1);
+	ClusterChain* chain = disk->clusterChains;
+	ASSERT_EQ(chain->length, 3);
+	ASSERT_EQ(ClusterChain_Head(chain), 2);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 1), 4);
+	ASSERT_EQ(ClusterChain_Tail(chain), 3);
+
+	FATImage_Free(disk);
+	PASS();
+}
+
+TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_RecordsCycleCrossLinkAndBadLink()
+{
+	FATImage* disk = FATImage_Make();
+	disk->information.dataSectorCount = 8;
+	// 2 > 3 > 4 > 3 is a cycle, 5 > 4 is a cross-link, 6 > 7 > 42 is out of range, 8 > 9 > 8 has no head
+	CopyTableValuesToClusterArray(disk, (uint16_t[]){ 0x000, 0x000, 0x003, 0x004, 0x003, 0x004, 0x007, 0x02A, 0x009, 0x008 }, 10);
+	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
+
+	ASSERT_EQ(disk->clusterChainsLength, 4);
+	ASSERT_EQ(disk->clusterChains[0].length, 3);
+	ASSERT_EQ(disk->clusterChains[1].length, 1);
+	ASSERT_EQ(disk->clusterChains[2].length, 2);
+	ASSERT_EQ(disk->clusterChains[3].length, 2);
+
+	ASSERT_EQ(disk->chainFindingsLength, 4);
+	ChainFinding* findings = disk->chainFindings;
+	ASSERT_EQ(findings[0].type, ChainCycle);
+	ASSERT_EQ(findings[0].head, 2); ASSERT_EQ(findings[0].cluster, 4); ASSERT_EQ(findings[0].target, 3);
+	ASSERT_EQ(findings[1].type, ChainCrossLink);
+	ASSERT_EQ(findings[1].head, 5); ASSERT_EQ(findings[1].cluster, 5); ASSERT_EQ(findings[1].target, 4);
+	ASSERT_EQ(findings[2].type, ChainBadLink);
+	ASSERT_EQ(findings[2].head, 6); ASSERT_EQ(findings[2].cluster, 7); ASSERT_EQ(findings[2].target, 42);
+	ASSERT_EQ(findings[3].type, ChainCycle);
+	ASSERT_EQ(findings[3].head, 8); ASSERT_EQ(findings[3].cluster, 9); ASSERT_EQ(findings[3].target, 8);
 
 	FATImage_Free(disk);
 	PASS();
 }
 
+TEST FATImage_ReadClusterIndexSequenceAndCreateFileChains_LinkIntoFreeClusterEndsChain()
+{
+	// 2 > 3 > 5 links into free cluster 5, 4 > 7 into bad cluster 7, 6 is a separate file
+	uint16_t values[] = { 0x000, 0x000, 0x003, 0x005, 0x007, 0x000, 0xFFF, 0xFF7 };
+	FATImage* disks[2];
+	size_t workers[2] = { 1, 3 };
+	for(size_t run = 0 ; run < 2 ; ++run)
+	{
+		disks[run] = FATImage_Make();
+		FATImage_SetWorkerCount(disks[run], workers[run]);
+		CopyTableValuesToClusterArray(disks[run], values, 8);
+		FATImage_ReadClusterIndexSequenceAndCreateFileChains(disks[run]);
+
+		FATImage* disk = disks[run];
+		ASSERT_EQ(disk->clusterChainsLength, 3);
+		ASSERT_EQ(disk->clusterChains[0].length, 2);
+		ASSERT_EQ(ClusterChain_Tail(disk->clusterChains + 0), 3);
+		ASSERT_EQ(disk->clusterChains[1].length, 1);
+		ASSERT_EQ(FATImage_GetClusterChain(disk, 5), NULL);
+		ASSERT_EQ(FATImage_GetClusterChain(disk, 7), NULL);
+
+		ASSERT_EQ(disk->chainFindingsLength, 2);
+		ChainFinding* findings = disk->chainFindings;
+		ASSERT_EQ(findings[0].type, ChainBadLink);
+		ASSERT_EQ(findings[0].head, 2); ASSERT_EQ(findings[0].cluster, 3); ASSERT_EQ(findings[0].target, 5);
+		ASSERT_EQ(findings[1].type, ChainBadLink);
+		ASSERT_EQ(findings[1].head, 4); ASSERT_EQ(findings[1].cluster, 4); ASSERT_EQ(findings[1].target, 7);
+	}
+
+	FATImage_Free(disks[0]);
+	FATImage_Free(disks[1]);
+	PASS();
+}
+
+void FATImage_LinkDirectoryEntry(FATImage* disk, ClusterChain* chain, DirectoryEntry* entry);
+
+TEST FATImage_GetClusterUsage_CountsReferencedAndUnreferencedClusters()
+{
+	FATImage* disk = FATImage_Make();
+	disk->information.dataSectorCount = 8;
+	CopyTableValuesToClusterArray(disk, (uint16_t[]){ 0x000, 0x000, 0x003, 0xFFF, 0x000, 0xFF7, 0x009, 0xFFF, 0xFF0, 0x007 }, 10);
+	FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
+
+	DirectoryEntry entry = { 0 };
+	FATImage_LinkDirectoryEntry(disk, FATImage_GetClusterChain(disk, 2), &entry);
+
+	FATClusterUsage usage;
+	FATImage_GetClusterUsage(disk, &usage);
+	ASSERT_EQ(usage.clusters, 8);
+	ASSERT_EQ(usage.free, 1);
+	ASSERT_EQ(usage.reserved, 1);
+	ASSERT_EQ(usage.bad, 1);
+	ASSERT_EQ(usage.file, 5);
+	ASSERT_EQ(usage.referenced, 2);
+	ASSERT_EQ(usage.unreferenced, 3);
+
+	size_t unreferenced[2];
+	ASSERT_EQ(FATImage_GetUnreferencedClusters(disk, unreferenced, 2), 3);
+	ASSERT_EQ(unreferenced[0], 6);
+	ASSERT_EQ(unreferenced[1], 7);
+
+	FATImage_Free(disk);
+	PASS();
+}
+
+TEST FATImage_ReadClusterChain_DecodesOnlyBlocksOnTheChain()
+{
+	FATImage* disk = FATImage_Make();
+	uint8_t* table = calloc(20000, 2);
+	FileAllocationTable_Initialize(&(disk->table), FAT16, table, 20000);
+	disk->information.clusterCount = 19998;
+
+	// 2 > 15000 > 3 is spread over two of the five blocks
+	FileAllocationTable_Write(&(disk->table), 2, 15000);
+	FileAllocationTable_Write(&(disk->table), 15000, 3);
+	FileAllocationTable_Write(&(disk->table), 3, 0xFFFF);
+
+	ClusterChain* chain = ClusterChain_Make();
+	ASSERT_EQ(FATImage_ReadClusterChain(disk, 2, chain), true);
+	ASSERT_EQ(chain->length, 3);
+	ASSERT_EQ(ClusterChain_IndexAt(chain, 1), 15000);
+	ASSERT_EQ(ClusterChain_Tail(chain), 3);
+	ASSERT_EQ(disk->clusterStatuses, NULL);
+	ASSERT_EQ(Bitset_Count(&(disk->decodedClusterBlocks)), 2);
+	ASSERT_EQ(FATImage_GetNextCluster(disk, 15000), 3);
+
+	ClusterChain_Free(chain);
+	disk->imageFileDescriptor = -1;
+	FATImage_Free(disk);
+	free(table);
+	PASS();
+}
+
+TEST FATImage_ReadClusterChain_StopsOnCycleAndBadLink()
+{
+	FATImage* disk = FATImage_Make();
+	uint8_t table[16] = { 0 };
+	FileAllocationTable_Initialize(&(disk->table), FAT16, table, 8);
+	disk->information.clusterCount = 6;
+
+	// 2 > 3 > 4 > 3 is a cycle, 5 > 6 > 42 is out of range
+	uint32_t values[] = { 0xFFF8, 0xFFFF, 3, 4, 3, 6, 42, 0 };
+	for(size_t index = 0 ; index < 8 ; ++index)
+		FileAllocationTable_Write(&(disk->table), index, values[index]);
+
+	ClusterChain* chain = ClusterChain_Make();
+	ASSERT_EQ(FATImage_ReadClusterChain(disk, 2, chain), false);
+	ASSERT_EQ(chain->length, 3);
+	ClusterChain_Free(chain);
+
+	chain = ClusterChain_Make();
+	ASSERT_EQ(FATImage_ReadClusterChain(disk, 5, chain), false);
+	ASSERT_EQ(chain->length, 2);
+	ClusterChain_Free(chain);
+
+	// 6 > 7 links into free cluster 7, which is left out
+	FileAllocationTable_Write(&(disk->table), 6, 7);
+	Bitset_Clear(&(disk->decodedClusterBlocks), 0);
+	chain = ClusterChain_Make();
+	ASSERT_EQ(FATImage_ReadClusterChain(disk, 6, chain), false);
+	ASSERT_EQ(chain->length, 1);
+	ClusterChain_Free(chain);
+
+	disk->imageFileDescriptor = -1;
+	FATImage_Free(disk);
+	PASS();
+}
+
+TEST FATImage_ReadFileAllocationTable_WorkersMatchSingleThread()
+{
+	uint8_t* table = calloc(20000, 2);
+	FileAllocationTable view;
+	FileAllocationTable_Initialize(&view, FAT16, table, 20000);
+	for(size_t index = 2 ; index < 20000 ; ++index)
+	{
+		// mix of free, bad, reserved, last and linked clusters crossing slab boundaries
+		size_t kind = (index * 7919) % 11;
+		uint32_t value = kind == 0 ? 0 : kind == 1 ? 0xFFF7 : kind == 2 ? 0xFFF2 : kind == 3 ? 0xFFFF : (index * 104729) % 19998 + 2;
+		FileAllocationTable_Write(&view, index, value);
+	}
+
+	FATImage* disks[2];
+	size_t workers[2] = { 1, 4 };
+	for(size_t run = 0 ; run < 2 ; ++run)
+	{
+		disks[run] = FATImage_Make();
+		disks[run]->table = view;
+		disks[run]->information.clusterCount = 19998;
+		disks[run]->imageFileDescriptor = -1;
+		FATImage_SetWorkerCount(disks[run], workers[run]);
+		FATImage_ReadFileAllocationTable(disks[run]);
+	}
+
+	ASSERT_EQ(memcmp(disks[0]->clusterValues, disks[1]->clusterValues, 20000 * sizeof(uint32_t)), 0);
+	ASSERT_EQ(memcmp(disks[0]->clusterStatuses, disks[1]->clusterStatuses, 20000), 0);
+	ASSERT_EQ(memcmp(disks[0]->clusterStatusCounts, disks[1]->clusterStatusCounts, sizeof(disks[0]->clusterStatusCounts)), 0);
+	ASSERT_EQ(Bitset_Count(&(disks[0]->fileClusters)), Bitset_Count(&(disks[1]->fileClusters)));
+	ASSERT_EQ(disks[0]->clusterChainsLength, disks[1]->clusterChainsLength);
+	ASSERT_EQ(memcmp(disks[0]->clusterChainIds, disks[1]->clusterChainIds, 20000 * sizeof(uint32_t)), 0);
+
+	// links into free, bad and reserved clusters end chains the same way on either builder
+	ASSERT(disks[0]->chainFindingsLength > 0);
+	ASSERT_EQ(disks[0]->chainFindingsLength, disks[1]->chainFindingsLength);
+	ASSERT_EQ(memcmp(disks[0]->chainFindings, disks[1]->chainFindings, disks[0]->chainFindingsLength * sizeof(ChainFinding)), 0);
+
+	FATImage_Free(disks[0]);
+	FATImage_Free(disks[1]);
+	free(table);
+	PASS();
+}
+
+TEST FATImage_EnableStats_CountsOnlyWhileEnabled()
+{
+	uint8_t* table = calloc(20000, 2);
+	FileAllocationTable view;
+	FileAllocationTable_Initialize(&view, FAT16, table, 20000);
+	for(size_t index = 2 ; index < 20000 ; ++index)
+	{
+		// runs of 3 clusters, every other run a file
+		size_t kind = index / 3 % 2;
+		FileAllocationTable_Write(&view, index, kind == 0 ? 0 : index % 3 == 2 ? 0xFFFF : index + 1);
+	}
+
+	FATImage* disks[2];
+	for(size_t run = 0 ; run < 2 ; ++run)
+	{
+		disks[run] = FATImage_Make();
+		disks[run]->table = view;
+		disks[run]->information.clusterCount = 19998;
+		disks[run]->imageFileDescriptor = -1;
+		FATImage_EnableStats(disks[run], run == 1);
+		FATImage_ReadFileAllocationTable(disks[run]);
+	}
+
+	FATImageStats disabled, enabled;
+	FATImage_GetStats(disks[0], &disabled);
+	FATImage_GetStats(disks[1], &enabled);
+	ASSERT_EQ(disabled.clustersClassified, 0);
+	ASSERT_EQ(disabled.chainsBuilt, 0);
+	ASSERT_EQ(disabled.phaseNanoseconds[FATPhaseClassify], 0);
+	ASSERT(disabled.arenaBytes > 0);
+
+	ASSERT_EQ(enabled.clustersClassified, 20000);
+	ASSERT_EQ(enabled.chainsBuilt, disks[1]->clusterChainsLength);
+	ASSERT(enabled.chainsBuilt > 0);
+	ASSERT_EQ(enabled.extentsAllocated, enabled.chainsBuilt);
+	ASSERT(enabled.phaseNanoseconds[FATPhaseClassify] > 0);
+	ASSERT(enabled.phaseNanoseconds[FATPhaseChains] > 0);
+	ASSERT_EQ(enabled.phaseNanoseconds[FATPhaseSave], 0);
+	ASSERT_EQ(strcmp(FATImage_PhaseName(FATPhaseChains), "chains"), 0);
+
+	FATImage_Free(disks[0]);
+	FATImage_Free(disks[1]);
+	free(table);
+	PASS();
+}
+
+TEST FATImage_ReadFileAllocationTable_PointerJumpingMatchesSerialBuilder()
+{
+	// chains of 1 to 37 clusters (length changing every 37 clusters) through runs of 4 contiguous clusters, with the runs visited in a scrambled order
+	size_t length = 20002;
+	uint8_t* table = calloc(length, 2);
+	FileAllocationTable view;
+	FileAllocationTable_Initialize(&view, FAT16, table, length);
+	size_t chainLength = 0;
+	for(size_t step = 0 ; step < length - 2 ; ++step)
+	{
+		// 7919 is coprime with the 5000 runs, so every cluster is visited once
+		size_t cluster = 2 + (step / 4 * 7919) % 5000 * 4 + step % 4;
+		size_t next = 2 + ((step + 1) / 4 * 7919) % 5000 * 4 + (step + 1) % 4;
+		chainLength += 1;
+		bool last = step + 1 == length - 2 || chainLength >= 1 + (step / 37) % 37;
+		FileAllocationTable_Write(&view, cluster, last ? 0xFFFF : next);
+		if(last)
+			chainLength = 0;
+	}
+
+	FATImage* disks[2];
+	size_t workers[2] = { 1, 3 };
+	for(size_t run = 0 ; run < 2 ; ++run)
+	{
+		disks[run] = FATImage_Make();
+		disks[run]->table = view;
+		disks[run]->information.clusterCount = length - 2;
+		disks[run]->imageFileDescriptor = -1;
+		FATImage_SetWorkerCount(disks[run], workers[run]);
+		FATImage_ReadFileAllocationTable(disks[run]);
+	}
+
+	ASSERT(disks[0]->clusterChainsLength > 100);
+	ASSERT_EQ(disks[0]->chainFindingsLength, 0);
+	ASSERT_EQ(disks[0]->clusterChainsLength, disks[1]->clusterChainsLength);
+	ASSERT_EQ(memcmp(disks[0]->clusterChainIds, disks[1]->clusterChainIds, length * sizeof(uint32_t)), 0);
+	for(size_t index = 0 ; index < disks[0]->clusterChainsLength ; ++index)
+	{
+		ClusterChain* serial = disks[0]->clusterChains + index;
+		ClusterChain* parallel = disks[1]->clusterChains + index;
+		ASSERT_EQ(serial->length, parallel->length);
+		ASSERT_EQ(serial->extentsLength, parallel->extentsLength);
+		ASSERT_EQ(memcmp(serial->extents, parallel->extents, serial->extentsLength * sizeof(ClusterExtent)), 0);
+	}
+
+	FATImage_Free(disks[0]);
+	FATImage_Free(disks[1]);
+	free(table);
+	PASS();
+}
+
+TEST FATImage_CompareFileAllocationTableCopies_ReportsEntryRangesAndMirrorRepairs()
+{
+	FATImage* disk = FATImage_Make();
+	uint8_t tables[3 * 512] = { 0 };
+	FileAllocationTable_Initialize(&(disk->table), FAT12, tables, 512 * 8 / 12);
+	disk->image = tables;
+	disk->imageSize = sizeof(tables);
+	disk->information.sectorSize = 512;
+	disk->information.fileAllocationTableSectorCount = 1;
+	disk->information.fileAllocationTableCopies = 3;
+
+	// copy 2 is stale for entries 4 and 5 (bytes 6-8), copy 3 differs in entry 300 and entries 339-340
+	FileAllocationTable_Write(&(disk->table), 4, 0xFFF);
+	FileAllocationTable_Write(&(disk->table), 5, 0x123);
+	memcpy(tables + 2 * 512, tables, 512);
+	tables[2 * 512 + 450] = 0x01;
+	tables[2 * 512 + 509] = 0xAA;
+	tables[2 * 512 + 510] = 0xAA;
+
+	ASSERT_EQ(FATImage_CompareFileAllocationTableCopies(disk), 3);
+	FATCopyMismatch* mismatches = disk->copyMismatches;
+	ASSERT_EQ(mismatches[0].copy, 1); ASSERT_EQ(mismatches[0].first, 4); ASSERT_EQ(mismatches[0].end, 6);
+	ASSERT_EQ(mismatches[1].copy, 2); ASSERT_EQ(mismatches[1].first, 300); ASSERT_EQ(mismatches[1].end, 301);
+	ASSERT_EQ(mismatches[2].copy, 2); ASSERT_EQ(mismatches[2].first, 339); ASSERT_EQ(mismatches[2].end, 341);
+
+	ASSERT_EQ(FATImage_MirrorFileAllocationTable(disk), 6);
+	ASSERT_EQ(memcmp(tables, tables + 512, 512), 0);
+	ASSERT_EQ(memcmp(tables, tables + 2 * 512, 512), 0);
+	ASSERT_EQ(FATImage_CompareFileAllocationTableCopies(disk), 0);
+
+	disk->image = NULL;
+	disk->imageSize = 0;
+	disk->imageFileDescriptor = -1;
+	FATImage_Free(disk);
+	PASS();
+}
+
+void FATImage_MarkDirty(FATImage* disk, uint8_t* start, size_t length);
+void FATImage_WriteTableEntry(FATImage* disk, size_t cluster, uint32_t value);
+size_t FATImage_CoalesceDirtyPages(FATImage* disk, size_t pageSize);
+
+TEST FATImage_CoalesceDirtyPages_MergesWritesIntoSortedPageRanges()
+{
+	FATImage* disk = FATImage_Make();
+	uint8_t image[16 * 512] = { 0 };
+	disk->image = image;
+	disk->imageSize = sizeof(image);
+	FileAllocationTable_Initialize(&(disk->table), FAT16, image + 512, 256);
+
+	// entries 10 and 11 touch, so they extend one range
+	FATImage_WriteTableEntry(disk, 10, 0xFFFF);
+	FATImage_WriteTableEntry(disk, 11, 0x0003);
+	ASSERT_EQ(disk->dirtyRangesLength, 1);
+	ASSERT_EQ(disk->dirtyRanges[0].offset, 512 + 20);
+	ASSERT_EQ(disk->dirtyRanges[0].length, 4);
+	ASSERT_EQ(image[512 + 20], 0xFF);
+
+	FATImage_MarkDirty(disk, image + 7 * 512 + 100, 32);
+	FATImage_MarkDirty(disk, image + 2 * 512 - 1, 2);
+	FATImage_MarkDirty(disk, image + 3 * 512, 1);
+	ASSERT_EQ(disk->dirtyRangesLength, 4);
+
+	// pages 1-3 merge (the second write spans pages 1 and 2), page 7 stays apart
+	ASSERT_EQ(FATImage_CoalesceDirtyPages(disk, 512), 2);
+	ASSERT_EQ(disk->dirtyRanges[0].offset, 512);
+	ASSERT_EQ(disk->dirtyRanges[0].length, 3 * 512);
+	ASSERT_EQ(disk->dirtyRanges[1].offset, 7 * 512);
+	ASSERT_EQ(disk->dirtyRanges[1].length, 512);
+
+	disk->image = NULL;
+	disk->imageSize = 0;
+	disk->imageFileDescriptor = -1;
+	FATImage_Free(disk);
+	PASS();
+}
+
+void FATImage_TruncateClusterChain(FATImage* disk, ClusterChain* chain, size_t newLength);
+
+TEST FATImage_TruncateClusterChain_UpdatesDecodedValuesAndStatuses()
+{
+	FATImage* disk = FATImage_Make();
+	uint8_t image[4 * 512] = { 0 };
+	disk->image = image;
+	disk->imageSize = sizeof(image);
+	FileAllocationTable_Initialize(&(disk->table), FAT16, image + 512, 16);
+	disk->information.clusterCount = 14;
+
+	// 2 > 3 > 4 > 5 is one file
+	uint32_t values[] = { 0xFFF8, 0xFFFF, 3, 4, 5, 0xFFFF };
+	for(size_t index = 0 ; index < 6 ; ++index)
+		FileAllocationTable_Write(&(disk->table), index, values[index]);
+	FATImage_ReadFileAllocationTable(disk);
+
+	DirectoryEntry entry = { .filename = "FILE", .extension = "TXT", .startCluster = 2 };
+	ClusterChain* chain = FATImage_GetClusterChain(disk, 2);
+	FATImage_LinkDirectoryEntry(disk, chain, &entry);
+	FATImage_TruncateClusterChain(disk, chain, 2);
+
+	// the decoded columns follow the table, so the chain reads back at its new length
+	ASSERT_EQ(FATImage_GetNextCluster(disk, 3), disk->table.endOfChain);
+	ASSERT_EQ(FATImage_GetNextCluster(disk, 4), 0);
+	ASSERT_EQ(disk->clusterStatuses[3], FileLast);
+	ASSERT_EQ(disk->clusterStatuses[4], Unused);
+	ASSERT_EQ(disk->clusterStatuses[5], Unused);
+	ASSERT_EQ(disk->clusterStatusCounts[File], 1);
+	ASSERT_EQ(disk->clusterStatusCounts[FileLast], 1);
+
+	ClusterChain* reread = ClusterChain_Make();
+	ASSERT_EQ(FATImage_ReadClusterChain(disk, 2, reread), true);
+	ASSERT_EQ(reread->length, 2);
+	ASSERT_EQ(ClusterChain_Tail(reread), 3);
+	ClusterChain_Free(reread);
+
+	disk->image = NULL;
+	disk->imageSize = 0;
+	disk->imageFileDescriptor = -1;
+	FATImage_Free(disk);
+	PASS();
+}
+
+TEST FATImage_SaveChanges_ReportsFailedWriteBack()
+{
+	FATImage* disk = FATImage_InitializeWithMode("images/floppy.img", FATImageReadOnly, FATImageBuffered);
+	FILE* output = tmpfile();
+	FATImage_SetOutput(disk, output, 0);
+	ASSERT(FATImage_UpdateDiskInformation(disk));
+
+	// the descriptor is still read-only, so writing the byte back fails and the image file is left alone
+	disk->mode = FATImageShared;
+	FATImage_MarkDirty(disk, FATImage_Access(disk, 0, 1), 1);
+	ASSERT_EQ(FATImage_SaveChanges(disk), 0);
+	ASSERT_EQ(disk->dirtyRangesLength, 0);
+	FATImage_Free(disk);
+
+	char buffer[256] = { 0 };
+	rewind(output);
+	ASSERT(fread(buffer, 1, sizeof(buffer) - 1, output) > 0);
+	ASSERT(strstr(buffer, "dos_scandisk: error writing image file: ") == buffer);
+	fclose(output);
+	PASS();
+}
+
 SUITE(FATImageTest)
 {
 	RUN_TEST(FATImage_Make_ReturnsZeroedOutStructWithZeroedOutFileChains);
 	RUN_TEST(FATImage_Initialize_ReturnsStructWithImageFileInfo);
+	RUN_TEST(FATImage_InitializeWithMode_ReadOnlyBecomesWritableOnRepair);
+	RUN_TEST(FATImage_InitializeWithMode_BufferedBackendReadsOnlyMetadata);
+	RUN_TEST(FATImage_Access_ReportsFailedReads);
 	RUN_TEST(FATImage_UpdateDiskInformation_Success);
+	RUN_TEST(FATImage_UpdateDiskInformation_RejectsMalformedBootSectors);
 	RUN_TEST(FATImage_GetNewFileChain_ReturnsNewItemAndUpdatesLength);
 	RUN_TEST(FATImage_GetNewFileChain_GrowsArrayAsNeeded);
 	RUN_TEST(FATImage_GetNewDirectoryEntry_ReturnsNewItemAndUpdatesLength);
 	RUN_TEST(FATImage_GetNewDirectoryEntry_GrowsArrayAsNeeded);
+	RUN_TEST(FATImage_GetNewDirectoryEntry_GrowingKeepsReferencesValid);
+	RUN_TEST(FATImage_ParseDirectoryEntry_StoresNamesInline);
 	RUN_TEST(FATImage_ReadClusterIndexSequenceAndCreateFileChains_UnusedBadReserved);
 	RUN_TEST(FATImage_ReadClusterIndexSequenceAndCreateFileChains_FourSeparateFiles);
 	RUN_TEST(FATImage_ReadClusterIndexSequenceAndCreateFileChains_OneBigFile);
 	RUN_TEST(FATImage_ReadClusterIndexSequenceAndCreateFileChains_ThreeFragmentedFiles);
-}
\ No newline at end of file
+	RUN_TEST(FATImage_ReadClusterIndexSequenceAndCreateFileChains_HeadAfterMiddle);
+	RUN_TEST(FATImage_ReadClusterIndexSequenceAndCreateFileChains_HeadlessCycle);
+	RUN_TEST(FATImage_ReadClusterIndexSequenceAndCreateFileChains_RecordsCycleCrossLinkAndBadLink);
+	RUN_TEST(FATImage_ReadClusterIndexSequenceAndCreateFileChains_LinkIntoFreeClusterEndsChain);
+	RUN_TEST(FATImage_GetClusterUsage_CountsReferencedAndUnreferencedClusters);
+	RUN_TEST(FATImage_ReadClusterChain_DecodesOnlyBlocksOnTheChain);
+	RUN_TEST(FATImage_ReadClusterChain_StopsOnCycleAndBadLink);
+	RUN_TEST(FATImage_ReadFileAllocationTable_WorkersMatchSingleThread);
+	RUN_TEST(FATImage_EnableStats_CountsOnlyWhileEnabled);
+	RUN_TEST(FATImage_ReadFileAllocationTable_PointerJumpingMatchesSerialBuilder);
+	RUN_TEST(FATImage_CompareFileAllocationTableCopies_ReportsEntryRangesAndMirrorRepairs);
+	RUN_TEST(FATImage_CoalesceDirtyPages_MergesWritesIntoSortedPageRanges);
+	RUN_TEST(FATImage_TruncateClusterChain_UpdatesDecodedValuesAndStatuses);
+	RUN_TEST(FATImage_SaveChanges_ReportsFailedWriteBack);
+}
@@ -0,0 +1,129 @@
+#include <assert.h>
+#include "FileAllocationTable.h"
+#include "Helpers.h"
+
+
+FATType FileAllocationTable_TypeForClusterCount(size_t clusterCount)
+{
+	if(clusterCount < 4085)
+		return FAT12;
+	if(clusterCount < 65525)
+		return FAT16;
+	return FAT32;
+}
+
+void FileAllocationTable_Initialize(FileAllocationTable* table, FATType type, uint8_t* base, size_t entryCount)
+{
+	assert(table != NULL);
+
+	// sentinels are the top of the entry range: 0x?F0-0x?F6 reserved, 0x?F7 bad, 0x?F8-0x?FF end of chain
+	uint32_t top = type == FAT12 ? 0xFFF : type == FAT16 ? 0xFFFF : 0x0FFFFFFF;
+	table->type = type;
+	table->base = base;
+	table->entryCount = entryCount;
+	table->reservedMin = top - 0xF;
+	table->bad = top - 0x8;
+	table->endOfChainMin = top - 0x7;
+	table->endOfChain = top;
+}
+
+uint32_t FileAllocationTable_Read(FileAllocationTable* table, size_t index)
+{
+	assert(table != NULL);
+	assert(table->base != NULL);
+	assert(index < table->entryCount);
+
+	uint8_t* entry;
+	switch(table->type)
+	{
+		case FAT12:
+			entry = table->base + index * 3 / 2;
+			if(index % 2 == 0)
+				return entry[0] | ((uint32_t)(entry[1] & 0x0F) << 8);
+			return (entry[0] >> 4) | ((uint32_t)entry[1] << 4);
+		case FAT16:
+			entry = table->base + index * 2;
+			return entry[0] | ((uint32_t)entry[1] << 8);
+		default:
+			entry = table->base + index * 4;
+			return (entry[0] | ((uint32_t)entry[1] << 8) | ((uint32_t)entry[2] << 16) | ((uint32_t)entry[3] << 24)) & 0x0FFFFFFF;
+	}
+}
+
+void FileAllocationTable_Write(FileAllocationTable* table, size_t index, uint32_t value)
+{
+	assert(table != NULL);
+	assert(table->base != NULL);
+	assert(index < table->entryCount);
+
+	switch(table->type)
+	{
+		case FAT12:
+			Write12BitLittleEndianSequence(value, table->base, index);
+			break;
+		case FAT16:
+			NumberTo8BitLittleEndianSequence(value, table->base + index * 2, 2);
+			break;
+		default:
+		{
+			uint8_t* entry = table->base + index * 4;
+			uint32_t reserved = NumberFrom8BitLittleEndianSequence(entry, 4) & 0xF0000000;
+			NumberTo8BitLittleEndianSequence(reserved | (value & 0x0FFFFFFF), entry, 4);
+			break;
+		}
+	}
+}
+
+static void FileAllocationTable_Decode12(FileAllocationTable* table, size_t first, size_t count, uint32_t* restrict destination)
+{
+	// odd entries share a byte with the previous entry, so start blocks on an even entry
+	if(first % 2 == 1 && count > 0)
+	{
+		*destination++ = FileAllocationTable_Read(table, first);
+		++first;
+		--count;
+	}
+
+	// the kernels widen to 32 bits in registers, so entries are written once
+	size_t bytes = (count * 3 + 1) / 2;
+	Read12BitLittleEndianSequenceWide(table->base + first * 3 / 2, bytes, destination, count);
+}
+
+/* restrict tells the compiler source and destination never overlap, so these loops vectorize without runtime checks */
+static void FileAllocationTable_Decode16(FileAllocationTable* table, size_t first, size_t count, uint32_t* restrict destination)
+{
+	const uint8_t* restrict source = table->base + first * 2;
+	for(size_t index = 0 ; index < count ; ++index)
+		destination[index] = source[2 * index] | ((uint32_t)source[2 * index + 1] << 8);
+}
+
+static void FileAllocationTable_Decode32(FileAllocationTable* table, size_t first, size_t count, uint32_t* restrict destination)
+{
+	const uint8_t* restrict source = table->base + first * 4;
+	for(size_t index = 0 ; index < count ; ++index)
+	{
+		const uint8_t* entry = source + 4 * index;
+		destination[index] = (entry[0] | ((uint32_t)entry[1] << 8) | ((uint32_t)entry[2] << 16) | ((uint32_t)entry[3] << 24)) & 0x0FFFFFFF;
+	}
+}
+
+void FileAllocationTable_Decode(FileAllocationTable* table, size_t first, size_t count, uint32_t* destination)
+{
+	assert(table != NULL);
+	assert(table->base != NULL);
+	assert(destination != NULL);
+	assert(first + count <= table->entryCount);
+
+	switch(table->type)
+	{
+		case FAT12:
+			FileAllocationTable_Decode12(table, first, count, destination);
+			break;
+		case FAT16:
+			FileAllocationTable_Decode16(table, first, count, destination);
+			break;
+		default:
+			FileAllocationTable_Decode32(table, first, count, destination);
+			break;
+	}
+}
@@ -0,0 +1,77 @@
+/** @file FileAllocationTable.h
+ *	@author Bandi Enkh-Amgalan
+ *  @brief Declaration of FileAllocationTable struct and supporting functions
+ *
+ *  FileAllocationTable is a view of a file allocation table in a mapped image, with decode and
+ *  encode kernels specialized for 12, 16 and 32-bit (28 bits used) entries. The sentinel values
+ *  (reserved, bad and end of chain) of the table type are stored alongside, so code classifying
+ *  entries can run unchanged on any entry width. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* File allocation table entry width */
+typedef enum
+{
+	FAT12 = 12,
+	FAT16 = 16,
+	FAT32 = 32
+} FATType;
+
+/* View of a file allocation table and the sentinel values of its type */
+typedef struct
+{
+	FATType type;
+	uint8_t* base;
+	size_t entryCount;
+	uint32_t reservedMin;
+	uint32_t bad;
+	uint32_t endOfChainMin;
+	uint32_t endOfChain;
+} FileAllocationTable;
+
+/** @brief	Determine the file allocation table type from the number of data clusters
+ *
+ *			The type of a FAT file system is defined by its cluster count alone: fewer than 4085 clusters
+ *			is FAT12, fewer than 65525 clusters is FAT16 and anything else is FAT32. 
+ *
+ *  @param 	clusterCount	number of clusters in the data area
+ *  @return file allocation table type */
+FATType FileAllocationTable_TypeForClusterCount(size_t clusterCount);
+
+/** @brief	Initialize a FileAllocationTable view
+ *
+ *  @param 	table
+ *  @param 	type
+ *  @param 	base		first byte of the table, may be NULL if the table is only used for classification
+ *  @param 	entryCount	number of entries in the table */
+void FileAllocationTable_Initialize(FileAllocationTable* table, FATType type, uint8_t* base, size_t entryCount);
+
+/** @brief	Read a single entry of a FileAllocationTable
+ *
+ *  @param 	table
+ *  @param 	index	entry index, must be less than entryCount
+ *  @return entry value (upper 4 bits are masked off for FAT32) */
+uint32_t FileAllocationTable_Read(FileAllocationTable* table, size_t index);
+
+/** @brief	Write a single entry of a FileAllocationTable
+ *
+ *			For FAT32, the upper 4 bits of the entry are reserved and are preserved. 
+ *
+ *  @param 	table
+ *  @param 	index	entry index, must be less than entryCount
+ *  @param 	value	new entry value */
+void FileAllocationTable_Write(FileAllocationTable* table, size_t index, uint32_t value);
+
+/** @brief	Decode a range of entries of a FileAllocationTable
+ *
+ *			FAT12 tables are decoded with Read12BitLittleEndianSequence() (and its vector kernels),
+ *			FAT16 and FAT32 tables with plain little endian loads. 
+ *
+ *  @param 	table
+ *  @param 	first		index of first entry to decode
+ *  @param 	count		number of entries to decode, first + count must not exceed entryCount
+ *  @param 	destination	array of at least count entries */
+void FileAllocationTable_Decode(FileAllocationTable* table, size_t first, size_t count, uint32_t* destination);
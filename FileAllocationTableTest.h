@@ -0,0 +1,108 @@
+#include "FileAllocationTable.h"
+
+TEST FileAllocationTable_TypeForClusterCount_Thresholds()
+{
+	ASSERT_EQ(FileAllocationTable_TypeForClusterCount(2847), FAT12);
+	ASSERT_EQ(FileAllocationTable_TypeForClusterCount(4084), FAT12);
+	ASSERT_EQ(FileAllocationTable_TypeForClusterCount(4085), FAT16);
+	ASSERT_EQ(FileAllocationTable_TypeForClusterCount(65524), FAT16);
+	ASSERT_EQ(FileAllocationTable_TypeForClusterCount(65525), FAT32);
+	PASS();
+}
+
+TEST FileAllocationTable_Initialize_Sentinels()
+{
+	FileAllocationTable table;
+	FileAllocationTable_Initialize(&table, FAT12, NULL, 0);
+	ASSERT_EQ(table.reservedMin, 0xFF0);
+	ASSERT_EQ(table.bad, 0xFF7);
+	ASSERT_EQ(table.endOfChainMin, 0xFF8);
+	ASSERT_EQ(table.endOfChain, 0xFFF);
+
+	FileAllocationTable_Initialize(&table, FAT16, NULL, 0);
+	ASSERT_EQ(table.bad, 0xFFF7);
+	ASSERT_EQ(table.endOfChainMin, 0xFFF8);
+
+	FileAllocationTable_Initialize(&table, FAT32, NULL, 0);
+	ASSERT_EQ(table.bad, 0x0FFFFFF7);
+	ASSERT_EQ(table.endOfChain, 0x0FFFFFFF);
+	PASS();
+}
+
+TEST FileAllocationTable_ReadWrite_FAT12()
+{
+	uint8_t bytes[6] = { 0 };
+	FileAllocationTable table;
+	FileAllocationTable_Initialize(&table, FAT12, bytes, 4);
+	FileAllocationTable_Write(&table, 1, 0xABC);
+	FileAllocationTable_Write(&table, 2, 0x123);
+	ASSERT_EQ(FileAllocationTable_Read(&table, 0), 0);
+	ASSERT_EQ(FileAllocationTable_Read(&table, 1), 0xABC);
+	ASSERT_EQ(FileAllocationTable_Read(&table, 2), 0x123);
+	ASSERT_EQ(FileAllocationTable_Read(&table, 3), 0);
+	PASS();
+}
+
+TEST FileAllocationTable_ReadWrite_FAT16()
+{
+	uint8_t bytes[6] = { 0 };
+	FileAllocationTable table;
+	FileAllocationTable_Initialize(&table, FAT16, bytes, 3);
+	FileAllocationTable_Write(&table, 1, 0xFFF7);
+	ASSERT_EQ(bytes[2], 0xF7);
+	ASSERT_EQ(bytes[3], 0xFF);
+	ASSERT_EQ(FileAllocationTable_Read(&table, 1), 0xFFF7);
+	ASSERT_EQ(FileAllocationTable_Read(&table, 2), 0);
+	PASS();
+}
+
+TEST FileAllocationTable_ReadWrite_FAT32PreservesReservedBits()
+{
+	uint8_t bytes[8] = { 0, 0, 0, 0, 0x78, 0x56, 0x34, 0xF2 };
+	FileAllocationTable table;
+	FileAllocationTable_Initialize(&table, FAT32, bytes, 2);
+	ASSERT_EQ(FileAllocationTable_Read(&table, 1), 0x02345678);
+
+	FileAllocationTable_Write(&table, 1, 0x0FFFFFFF);
+	ASSERT_EQ(bytes[7], 0xFF);
+	FileAllocationTable_Write(&table, 1, 0x00000003);
+	ASSERT_EQ(bytes[4], 0x03);
+	ASSERT_EQ(bytes[7], 0xF0);
+	ASSERT_EQ(FileAllocationTable_Read(&table, 1), 3);
+	PASS();
+}
+
+TEST FileAllocationTable_Decode_MatchesRead()
+{
+	uint8_t bytes[4000];
+	for(size_t index = 0 ; index < sizeof(bytes) ; ++index)
+		bytes[index] = (uint8_t)(index * 131 + 7);
+
+	FATType types[] = { FAT12, FAT16, FAT32 };
+	uint32_t decoded[2700];
+	for(size_t type = 0 ; type < 3 ; ++type)
+	{
+		FileAllocationTable table;
+		size_t entries = sizeof(bytes) * 8 / types[type];
+		FileAllocationTable_Initialize(&table, types[type], bytes, entries);
+
+		// odd starts exercise the FAT12 entry sharing a byte with its predecessor
+		for(size_t first = 0 ; first < 5 ; ++first)
+		{
+			FileAllocationTable_Decode(&table, first, entries - first, decoded);
+			for(size_t index = first ; index < entries ; ++index)
+				ASSERT_EQ_FMT(FileAllocationTable_Read(&table, index), decoded[index - first], "%u");
+		}
+	}
+	PASS();
+}
+
+SUITE(FileAllocationTableTest)
+{
+	RUN_TEST(FileAllocationTable_TypeForClusterCount_Thresholds);
+	RUN_TEST(FileAllocationTable_Initialize_Sentinels);
+	RUN_TEST(FileAllocationTable_ReadWrite_FAT12);
+	RUN_TEST(FileAllocationTable_ReadWrite_FAT16);
+	RUN_TEST(FileAllocationTable_ReadWrite_FAT32PreservesReservedBits);
+	RUN_TEST(FileAllocationTable_Decode_MatchesRead);
+}
@@ -2,7 +2,12 @@
 #include <assert.h>
 #include <ctype.h>
 
-void Read12BitLittleEndianSequence(uint8_t* source, size_t sourceLength, uint16_t* destination, size_t destinationLength)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HELPERS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+static void Read12BitLittleEndianSequence_Scalar(uint8_t* source, size_t sourceLength, uint16_t* destination, size_t destinationLength)
 {
 	assert(source != NULL);
 	assert(destination != NULL);
@@ -36,6 +41,222 @@ void Read12BitLittleEndianSequence(uint8_t* source, size_t sourceLength, uint16_
 	}
 }
 
+/* Same as the 16-bit scalar kernel, writing 32-bit entries */
+static void Read12BitLittleEndianSequenceWide_Scalar(uint8_t* source, size_t sourceLength, uint32_t* destination, size_t destinationLength)
+{
+	assert(source != NULL);
+	assert(destination != NULL);
+	for(size_t index = 0 ; index < destinationLength ; ++index)
+	{
+		// entry i spans bytes i * 3 / 2 and the one after it
+		size_t byteIndex = index * 3 / 2;
+		if(byteIndex + 1 >= sourceLength)
+			break;
+		if(index % 2 == 0)
+			destination[index] = source[byteIndex] | ((uint32_t)(source[byteIndex + 1] & 0x0F) << 8);
+		else
+			destination[index] = (source[byteIndex] >> 4) | ((uint32_t)source[byteIndex + 1] << 4);
+	}
+}
+
+#ifdef HELPERS_X86_KERNELS
+/* Expands a 12-byte group (four 3-byte pairs) into eight 16-bit entries. Each 16-bit lane receives the two bytes
+ * holding its entry, then even lanes keep their low 12 bits and odd lanes keep their high 12 bits. */
+__attribute__((target("ssse3")))
+static inline __m128i Read12BitLittleEndianSequence_Expand128(const uint8_t* group)
+{
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+	const __m128i evenMask = _mm_set1_epi32(0x00000FFF);
+	const __m128i oddMask = _mm_set1_epi32((int)0xFFFF0000);
+
+	// every load reads 16 bytes, of which 12 are used
+	__m128i bytes = _mm_loadu_si128((const __m128i*)group);
+	__m128i pairs = _mm_shuffle_epi8(bytes, shuffle);
+	__m128i even = _mm_and_si128(pairs, evenMask);
+	__m128i odd = _mm_and_si128(_mm_srli_epi16(pairs, 4), oddMask);
+	return _mm_or_si128(even, odd);
+}
+
+/* Same as Read12BitLittleEndianSequence_Expand128(), but expands two 12-byte groups (one per 128-bit lane) into sixteen entries */
+__attribute__((target("avx2")))
+static inline __m256i Read12BitLittleEndianSequence_Expand256(const uint8_t* groups)
+{
+	const __m256i shuffle = _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11,
+											 0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+	const __m256i evenMask = _mm256_set1_epi32(0x00000FFF);
+	const __m256i oddMask = _mm256_set1_epi32((int)0xFFFF0000);
+
+	// the upper lane loads 16 bytes starting at byte 12
+	__m128i low = _mm_loadu_si128((const __m128i*)groups);
+	__m128i high = _mm_loadu_si128((const __m128i*)(groups + 12));
+	__m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+	__m256i pairs = _mm256_shuffle_epi8(bytes, shuffle);
+	__m256i even = _mm256_and_si256(pairs, evenMask);
+	__m256i odd = _mm256_and_si256(_mm256_srli_epi16(pairs, 4), oddMask);
+	return _mm256_or_si256(even, odd);
+}
+
+/* Number of 12-byte groups the SSSE3 kernels can expand without reading past source or writing past destination */
+static size_t Read12BitLittleEndianSequence_SSSE3Blocks(size_t sourceLength, size_t destinationLength)
+{
+	size_t blocks = sourceLength >= 16 ? (sourceLength - 16) / 12 + 1 : 0;
+	return blocks < destinationLength / 8 ? blocks : destinationLength / 8;
+}
+
+/* Number of 24-byte group pairs the AVX2 kernels can expand */
+static size_t Read12BitLittleEndianSequence_AVX2Blocks(size_t sourceLength, size_t destinationLength)
+{
+	size_t blocks = sourceLength >= 28 ? (sourceLength - 28) / 24 + 1 : 0;
+	return blocks < destinationLength / 16 ? blocks : destinationLength / 16;
+}
+
+__attribute__((target("ssse3")))
+static void Read12BitLittleEndianSequence_SSSE3(uint8_t* source, size_t sourceLength, uint16_t* destination, size_t destinationLength)
+{
+	size_t blocks = Read12BitLittleEndianSequence_SSSE3Blocks(sourceLength, destinationLength);
+	for(size_t block = 0 ; block < blocks ; ++block)
+		_mm_storeu_si128((__m128i*)(destination + block * 8), Read12BitLittleEndianSequence_Expand128(source + block * 12));
+
+	Read12BitLittleEndianSequence_Scalar(source + blocks * 12, sourceLength - blocks * 12, destination + blocks * 8, destinationLength - blocks * 8);
+}
+
+__attribute__((target("avx2")))
+static void Read12BitLittleEndianSequence_AVX2(uint8_t* source, size_t sourceLength, uint16_t* destination, size_t destinationLength)
+{
+	size_t blocks = Read12BitLittleEndianSequence_AVX2Blocks(sourceLength, destinationLength);
+	for(size_t block = 0 ; block < blocks ; ++block)
+		_mm256_storeu_si256((__m256i*)(destination + block * 16), Read12BitLittleEndianSequence_Expand256(source + block * 24));
+
+	Read12BitLittleEndianSequence_SSSE3(source + blocks * 24, sourceLength - blocks * 24, destination + blocks * 16, destinationLength - blocks * 16);
+}
+
+/* Widens the eight entries of each group by interleaving them with zeros */
+__attribute__((target("ssse3")))
+static void Read12BitLittleEndianSequenceWide_SSSE3(uint8_t* source, size_t sourceLength, uint32_t* destination, size_t destinationLength)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t blocks = Read12BitLittleEndianSequence_SSSE3Blocks(sourceLength, destinationLength);
+	for(size_t block = 0 ; block < blocks ; ++block)
+	{
+		__m128i entries = Read12BitLittleEndianSequence_Expand128(source + block * 12);
+		_mm_storeu_si128((__m128i*)(destination + block * 8), _mm_unpacklo_epi16(entries, zero));
+		_mm_storeu_si128((__m128i*)(destination + block * 8 + 4), _mm_unpackhi_epi16(entries, zero));
+	}
+
+	Read12BitLittleEndianSequenceWide_Scalar(source + blocks * 12, sourceLength - blocks * 12, destination + blocks * 8, destinationLength - blocks * 8);
+}
+
+/* Widens each 128-bit lane of eight entries (the lanes hold entries 0-7 and 8-15) into a 256-bit store */
+__attribute__((target("avx2")))
+static void Read12BitLittleEndianSequenceWide_AVX2(uint8_t* source, size_t sourceLength, uint32_t* destination, size_t destinationLength)
+{
+	size_t blocks = Read12BitLittleEndianSequence_AVX2Blocks(sourceLength, destinationLength);
+	for(size_t block = 0 ; block < blocks ; ++block)
+	{
+		__m256i entries = Read12BitLittleEndianSequence_Expand256(source + block * 24);
+		_mm256_storeu_si256((__m256i*)(destination + block * 16), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(entries)));
+		_mm256_storeu_si256((__m256i*)(destination + block * 16 + 8), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(entries, 1)));
+	}
+
+	Read12BitLittleEndianSequenceWide_SSSE3(source + blocks * 24, sourceLength - blocks * 24, destination + blocks * 16, destinationLength - blocks * 16);
+}
+#endif
+
+bool DecodeKernel_IsSupported(DecodeKernel kernel)
+{
+	switch(kernel)
+	{
+		case DecodeKernelScalar:
+			return true;
+#ifdef HELPERS_X86_KERNELS
+		case DecodeKernelSSSE3:
+			return __builtin_cpu_supports("ssse3");
+		case DecodeKernelAVX2:
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return false;
+	}
+}
+
+DecodeKernel DecodeKernel_Best()
+{
+	if(DecodeKernel_IsSupported(DecodeKernelAVX2))
+		return DecodeKernelAVX2;
+	if(DecodeKernel_IsSupported(DecodeKernelSSSE3))
+		return DecodeKernelSSSE3;
+	return DecodeKernelScalar;
+}
+
+const char* DecodeKernel_Name(DecodeKernel kernel)
+{
+	switch(kernel)
+	{
+		case DecodeKernelScalar:
+			return "scalar";
+		case DecodeKernelSSSE3:
+			return "ssse3";
+		case DecodeKernelAVX2:
+			return "avx2";
+		default:
+			return "unknown";
+	}
+}
+
+void Read12BitLittleEndianSequenceWithKernel(DecodeKernel kernel, uint8_t* source, size_t sourceLength, uint16_t* destination, size_t destinationLength)
+{
+	assert(source != NULL);
+	assert(destination != NULL);
+	assert(DecodeKernel_IsSupported(kernel));
+
+	switch(kernel)
+	{
+#ifdef HELPERS_X86_KERNELS
+		case DecodeKernelAVX2:
+			Read12BitLittleEndianSequence_AVX2(source, sourceLength, destination, destinationLength);
+			break;
+		case DecodeKernelSSSE3:
+			Read12BitLittleEndianSequence_SSSE3(source, sourceLength, destination, destinationLength);
+			break;
+#endif
+		default:
+			Read12BitLittleEndianSequence_Scalar(source, sourceLength, destination, destinationLength);
+			break;
+	}
+}
+
+void Read12BitLittleEndianSequence(uint8_t* source, size_t sourceLength, uint16_t* destination, size_t destinationLength)
+{
+	Read12BitLittleEndianSequenceWithKernel(DecodeKernel_Best(), source, sourceLength, destination, destinationLength);
+}
+
+void Read12BitLittleEndianSequenceWideWithKernel(DecodeKernel kernel, uint8_t* source, size_t sourceLength, uint32_t* destination, size_t destinationLength)
+{
+	assert(source != NULL);
+	assert(destination != NULL);
+	assert(DecodeKernel_IsSupported(kernel));
+
+	switch(kernel)
+	{
+#ifdef HELPERS_X86_KERNELS
+		case DecodeKernelAVX2:
+			Read12BitLittleEndianSequenceWide_AVX2(source, sourceLength, destination, destinationLength);
+			break;
+		case DecodeKernelSSSE3:
+			Read12BitLittleEndianSequenceWide_SSSE3(source, sourceLength, destination, destinationLength);
+			break;
+#endif
+		default:
+			Read12BitLittleEndianSequenceWide_Scalar(source, sourceLength, destination, destinationLength);
+			break;
+	}
+}
+
+void Read12BitLittleEndianSequenceWide(uint8_t* source, size_t sourceLength, uint32_t* destination, size_t destinationLength)
+{
+	Read12BitLittleEndianSequenceWideWithKernel(DecodeKernel_Best(), source, sourceLength, destination, destinationLength);
+}
+
 void Write12BitLittleEndianSequence(uint16_t number, uint8_t* destination, size_t index)
 {
 	assert(destination != NULL);
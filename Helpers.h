@@ -5,6 +5,16 @@
 #pragma once
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+/* Implementations of Read12BitLittleEndianSequence(), selected at runtime based on CPU support */
+typedef enum
+{
+	DecodeKernelScalar = 0,
+	DecodeKernelSSSE3,
+	DecodeKernelAVX2,
+	DecodeKernelCount
+} DecodeKernel;
 
 /** @brief	Parse stream of data holding 12-bit Little endian numbers
  *
@@ -22,6 +32,67 @@
  */
 void Read12BitLittleEndianSequence(uint8_t* source, size_t sourceLength, uint16_t* destination, size_t destinationLength);
 
+/** @brief	Parse stream of data holding 12-bit Little endian numbers using a specific kernel
+ *
+ *	Behaves exactly like Read12BitLittleEndianSequence(), but uses the specified kernel instead of
+ *	the fastest one supported by the CPU. The vector kernels expand 3-byte pairs in wide blocks and
+ *	hand the remaining tail over to the scalar kernel, so all kernels produce identical output.
+ *
+ *	Caller must make sure that the kernel is supported, see DecodeKernel_IsSupported().
+ *
+ *	@param kernel
+ *	@param source array of 8-bit unsigned integers
+ *	@param sourceLength length of source array
+ *  @param destination array of 16-bit unsigned integers
+ *	@param sourceLength length of destination array
+ */
+void Read12BitLittleEndianSequenceWithKernel(DecodeKernel kernel, uint8_t* source, size_t sourceLength, uint16_t* destination, size_t destinationLength);
+
+/** @brief	Parse stream of data holding 12-bit Little endian numbers into 32-bit numbers
+ *
+ *	Same as Read12BitLittleEndianSequence(), but the vector kernels widen entries to 32 bits in registers,
+ *	so callers decoding into 32-bit arrays need no separate widening pass.
+ *
+ *	@param source array of 8-bit unsigned integers
+ *	@param sourceLength length of source array
+ *  @param destination array of 32-bit unsigned integers
+ *	@param destinationLength length of destination array
+ */
+void Read12BitLittleEndianSequenceWide(uint8_t* source, size_t sourceLength, uint32_t* destination, size_t destinationLength);
+
+/** @brief	Parse stream of data holding 12-bit Little endian numbers into 32-bit numbers using a specific kernel
+ *
+ *	Behaves exactly like Read12BitLittleEndianSequenceWide(), but uses the specified kernel.
+ *	Caller must make sure that the kernel is supported, see DecodeKernel_IsSupported().
+ *
+ *	@param kernel
+ *	@param source array of 8-bit unsigned integers
+ *	@param sourceLength length of source array
+ *  @param destination array of 32-bit unsigned integers
+ *	@param destinationLength length of destination array
+ */
+void Read12BitLittleEndianSequenceWideWithKernel(DecodeKernel kernel, uint8_t* source, size_t sourceLength, uint32_t* destination, size_t destinationLength);
+
+/** @brief	Check if the current CPU (and build) supports a decode kernel
+ *
+ *	@param kernel
+ *	@return true if kernel can be used, false otherwise
+ */
+bool DecodeKernel_IsSupported(DecodeKernel kernel);
+
+/** @brief	Get the fastest decode kernel supported by the current CPU
+ *
+ *	@return kernel used by Read12BitLittleEndianSequence()
+ */
+DecodeKernel DecodeKernel_Best();
+
+/** @brief	Get a human readable name for a decode kernel
+ *
+ *	@param kernel
+ *	@return static string naming the kernel
+ */
+const char* DecodeKernel_Name(DecodeKernel kernel);
+
 /** @brief	Write a number into a buffer holding 12-bit Little endian numbers at the specified index 
  *
  *	The index i refers to the i-th 12-bit number in the destination buffer.
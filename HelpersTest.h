@@ -16,6 +16,65 @@ TEST Read12BitLittleEndianSequence_Success()
 	PASS();
 }
 
+TEST Read12BitLittleEndianSequence_AllKernelsMatchScalar()
+{
+	uint8_t values[1000];
+	for(size_t index = 0 ; index < sizeof(values) ; ++index)
+		values[index] = (uint8_t)(index * 167 + 13);
+
+	uint16_t expected[700];
+	uint16_t converted[700];
+	for(int kernel = DecodeKernelScalar + 1 ; kernel < DecodeKernelCount ; ++kernel)
+	{
+		if(!DecodeKernel_IsSupported(kernel))
+			continue;
+
+		// odd lengths exercise the scalar tail after the vector blocks
+		for(size_t sourceLength = 0 ; sourceLength <= sizeof(values) ; sourceLength += 37)
+		{
+			for(size_t destinationLength = 0 ; destinationLength <= 700 ; destinationLength += 101)
+			{
+				memset(expected, 0xAB, sizeof(expected));
+				memset(converted, 0xAB, sizeof(converted));
+				Read12BitLittleEndianSequenceWithKernel(DecodeKernelScalar, values, sourceLength, expected, destinationLength);
+				Read12BitLittleEndianSequenceWithKernel(kernel, values, sourceLength, converted, destinationLength);
+				ASSERT_MEM_EQ(expected, converted, sizeof(expected));
+			}
+		}
+	}
+	PASS();
+}
+
+TEST Read12BitLittleEndianSequenceWide_AllKernelsMatchNarrow()
+{
+	uint8_t values[1000];
+	for(size_t index = 0 ; index < sizeof(values) ; ++index)
+		values[index] = (uint8_t)(index * 167 + 13);
+
+	uint16_t expected[700];
+	uint32_t converted[701];
+	for(int kernel = DecodeKernelScalar ; kernel < DecodeKernelCount ; ++kernel)
+	{
+		if(!DecodeKernel_IsSupported(kernel))
+			continue;
+
+		for(size_t sourceLength = 0 ; sourceLength <= sizeof(values) ; sourceLength += 37)
+		{
+			for(size_t destinationLength = 0 ; destinationLength <= 700 ; destinationLength += 101)
+			{
+				memset(expected, 0, sizeof(expected));
+				memset(converted, 0, sizeof(converted));
+				Read12BitLittleEndianSequenceWithKernel(DecodeKernelScalar, values, sourceLength, expected, destinationLength);
+				Read12BitLittleEndianSequenceWideWithKernel(kernel, values, sourceLength, converted, destinationLength);
+				for(size_t index = 0 ; index < 700 ; ++index)
+					ASSERT_EQ_FMT((uint32_t)expected[index], converted[index], "%u");
+				ASSERT_EQ(converted[700], 0);
+			}
+		}
+	}
+	PASS();
+}
+
 TEST CopyUntilFirstSpace_AllSpaces()
 {
 	char source[] = "       ";
@@ -95,6 +154,8 @@ TEST Write12BitLittleEndianSequence_Success()
 SUITE(HelpersTest)
 {
 	RUN_TEST(Read12BitLittleEndianSequence_Success);
+	RUN_TEST(Read12BitLittleEndianSequence_AllKernelsMatchScalar);
+	RUN_TEST(Read12BitLittleEndianSequenceWide_AllKernelsMatchNarrow);
 	RUN_TEST(CopyUntilFirstSpace_AllSpaces);
 	RUN_TEST(CopyUntilFirstSpace_OneWord);
 	RUN_TEST(CopyUntilFirstSpace_TwoWords);
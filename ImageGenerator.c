@@ -0,0 +1,298 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "FileAllocationTable.h"
+#include "ImageGenerator.h"
+
+#define SECTOR_SIZE 512
+#define FILES_PER_DIRECTORY 64
+#define ROOT_ENTRIES 512
+
+typedef struct
+{
+	ImageGeneratorOptions* options;
+	int fileDescriptor;
+	FileAllocationTable table;
+	size_t clusterSize;
+	size_t dataStart;
+	uint32_t random;
+
+	/* Next cluster handed out, clusters are allocated front to back */
+	size_t nextCluster;
+
+	/* Clusters of the last allocation */
+	size_t* clusters;
+	size_t clustersCapacity;
+
+	/* Set once an allocation or write fails, the image is incomplete */
+	bool failed;
+} ImageGenerator;
+
+/* xorshift32, so images only depend on the seed */
+static uint32_t ImageGenerator_Random(ImageGenerator* generator)
+{
+	uint32_t state = generator->random;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	generator->random = state;
+	return state;
+}
+
+static void ImageGenerator_Put(uint8_t* base, size_t offset, uint32_t value, size_t bytes)
+{
+	for(size_t index = 0 ; index < bytes ; ++index)
+		base[offset + index] = (uint8_t)(value >> (8 * index));
+}
+
+/* allocates and links a chain of length clusters into generator->clusters, returns false if the data area is full */
+static bool ImageGenerator_Allocate(ImageGenerator* generator, size_t length)
+{
+	// a fragmented chain skips at most 8 clusters before each of its clusters
+	size_t end = generator->table.entryCount;
+	size_t worstCase = generator->options->fragmentation > 0 ? 9 * length : length;
+	if(generator->nextCluster + worstCase > end)
+		return false;
+
+	if(length > generator->clustersCapacity)
+	{
+		size_t* clusters = realloc(generator->clusters, 2 * length * sizeof(size_t));
+		if(clusters == NULL)
+		{
+			generator->failed = true;
+			return false;
+		}
+		generator->clusters = clusters;
+		generator->clustersCapacity = 2 * length;
+	}
+
+	for(size_t index = 0 ; index < length ; ++index)
+	{
+		if(index > 0 && ImageGenerator_Random(generator) % 100 < generator->options->fragmentation)
+			generator->nextCluster += 1 + ImageGenerator_Random(generator) % 8;
+		generator->clusters[index] = generator->nextCluster++;
+		if(index > 0)
+			FileAllocationTable_Write(&(generator->table), generator->clusters[index - 1], generator->clusters[index]);
+	}
+	FileAllocationTable_Write(&(generator->table), generator->clusters[length - 1], generator->table.endOfChain);
+	return true;
+}
+
+static void ImageGenerator_WriteEntry(uint8_t* entry, const char* name, uint8_t attributes, size_t startCluster, size_t fileSize)
+{
+	memcpy(entry, name, 11);
+	entry[11] = attributes;
+	ImageGenerator_Put(entry, 20, startCluster >> 16, 2);
+	ImageGenerator_Put(entry, 26, startCluster & 0xFFFF, 2);
+	ImageGenerator_Put(entry, 28, fileSize, 4);
+}
+
+/* writes length bytes at offset, retrying interrupted and short writes, and marks the generator failed on an error */
+static void ImageGenerator_WriteAll(ImageGenerator* generator, const uint8_t* data, size_t length, size_t offset)
+{
+	while(length > 0 && !generator->failed)
+	{
+		ssize_t count = pwrite(generator->fileDescriptor, data, length, offset);
+		if(count == -1 && errno == EINTR)
+			continue;
+		if(count <= 0)
+			generator->failed = true;
+		else
+		{
+			data += count;
+			length -= count;
+			offset += count;
+		}
+	}
+}
+
+/* writes a directory to the clusters of the last allocation */
+static void ImageGenerator_WriteDirectory(ImageGenerator* generator, uint8_t* entries, size_t clusterCount)
+{
+	for(size_t index = 0 ; index < clusterCount ; ++index)
+	{
+		size_t offset = generator->dataStart + (generator->clusters[index] - 2) * generator->clusterSize;
+		ImageGenerator_WriteAll(generator, entries + index * generator->clusterSize, generator->clusterSize, offset);
+	}
+}
+
+/* closes the image file and frees the generator's buffers, keeping errno for the caller */
+static void ImageGenerator_Release(ImageGenerator* generator, void** buffers, size_t bufferCount)
+{
+	int currentError = errno;
+	if(generator->fileDescriptor != -1)
+		close(generator->fileDescriptor);
+	for(size_t index = 0 ; index < bufferCount ; ++index)
+		free(buffers[index]);
+	free(generator->clusters);
+	errno = currentError;
+}
+
+static size_t ImageGenerator_ClustersFor(ImageGenerator* generator, size_t entryCount)
+{
+	size_t clusters = (entryCount * 32 + generator->clusterSize - 1) / generator->clusterSize;
+	return clusters > 0 ? clusters : 1;
+}
+
+ssize_t ImageGenerator_Write(const char* path, ImageGeneratorOptions* options)
+{
+	assert(path != NULL);
+	assert(options != NULL);
+	assert(options->clusterCount > 0 && options->sectorsPerCluster > 0);
+
+	ImageGenerator generator = { .options = options };
+	generator.random = options->seed != 0 ? options->seed : 1;
+	generator.clusterSize = options->sectorsPerCluster * SECTOR_SIZE;
+	generator.nextCluster = 2;
+
+	// region layout of the specification: reserved sectors, table copies, FAT12/FAT16 root directory, data area
+	FATType type = FileAllocationTable_TypeForClusterCount(options->clusterCount);
+	size_t reservedSectors = type == FAT32 ? 32 : 1;
+	size_t rootEntries = type == FAT32 ? 0 : ROOT_ENTRIES;
+	size_t rootSectors = rootEntries * 32 / SECTOR_SIZE;
+	size_t tableSectors = (((options->clusterCount + 2) * type + 7) / 8 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+	size_t dataSector = reservedSectors + 2 * tableSectors + rootSectors;
+	size_t sectorCount = dataSector + options->clusterCount * options->sectorsPerCluster;
+	generator.dataStart = dataSector * SECTOR_SIZE;
+
+	// every file lives in a subdirectory of the root directory, which must hold them all next to the volume label
+	size_t filesPerDirectory = FILES_PER_DIRECTORY;
+	if(type != FAT32 && (options->fileCount + filesPerDirectory - 1) / filesPerDirectory > rootEntries - 1)
+		filesPerDirectory = (options->fileCount + rootEntries - 2) / (rootEntries - 1);
+	size_t directoryCount = (options->fileCount + filesPerDirectory - 1) / filesPerDirectory;
+	size_t rootClusters = ImageGenerator_ClustersFor(&generator, directoryCount + 1);
+	size_t directoryClusters = ImageGenerator_ClustersFor(&generator, filesPerDirectory + 2);
+
+	// buffers and the file are set up front, so a failure has nothing half written to unwind
+	uint8_t* table = calloc(tableSectors, SECTOR_SIZE);
+	uint8_t* root = calloc(type == FAT32 ? rootClusters * generator.clusterSize : rootEntries * 32, 1);
+	size_t* rootChain = malloc(rootClusters * sizeof(size_t));
+	uint8_t* directory = malloc(directoryClusters * generator.clusterSize);
+	size_t* directoryChain = malloc(directoryClusters * sizeof(size_t));
+	void* buffers[] = { table, root, rootChain, directory, directoryChain };
+	generator.fileDescriptor = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	bool ready = generator.fileDescriptor != -1 && ftruncate(generator.fileDescriptor, sectorCount * SECTOR_SIZE) == 0;
+	for(size_t index = 0 ; index < 5 && ready ; ++index)
+		ready = buffers[index] != NULL;
+	if(!ready)
+	{
+		ImageGenerator_Release(&generator, buffers, 5);
+		return -1;
+	}
+
+	FileAllocationTable_Initialize(&(generator.table), type, table, options->clusterCount + 2);
+	FileAllocationTable_Write(&(generator.table), 0, generator.table.endOfChain - 7);
+	FileAllocationTable_Write(&(generator.table), 1, generator.table.endOfChain);
+
+	size_t rootCluster = 0;
+	if(type == FAT32)
+	{
+		if(!ImageGenerator_Allocate(&generator, rootClusters))
+		{
+			ImageGenerator_Release(&generator, buffers, 5);
+			errno = generator.failed ? errno : ENOSPC;
+			return -1;
+		}
+		rootCluster = generator.clusters[0];
+		memcpy(rootChain, generator.clusters, rootClusters * sizeof(size_t));
+	}
+	ImageGenerator_WriteEntry(root, "SYNTHETIC  ", 0x08, 0, 0);
+
+	// about half of the data area goes to files, lengths are uniform around the average
+	size_t averageLength = options->fileCount > 0 ? options->clusterCount / 2 / options->fileCount : 1;
+	if(averageLength == 0)
+		averageLength = 1;
+	size_t cycleStride = options->cycles > 0 ? options->fileCount / options->cycles : 0;
+	size_t mismatchStride = options->sizeMismatches > 0 ? options->fileCount / options->sizeMismatches : 0;
+	size_t cycles = 0;
+	size_t mismatches = 0;
+
+	char name[20];
+	size_t fileCount = 0;
+	bool full = false;
+	for(size_t directoryIndex = 0 ; directoryIndex < directoryCount && !full ; ++directoryIndex)
+	{
+		if(!ImageGenerator_Allocate(&generator, directoryClusters))
+			break;
+		memcpy(directoryChain, generator.clusters, directoryClusters * sizeof(size_t));
+		memset(directory, 0, directoryClusters * generator.clusterSize);
+		ImageGenerator_WriteEntry(directory, ".          ", 0x10, directoryChain[0], 0);
+		ImageGenerator_WriteEntry(directory + 32, "..         ", 0x10, 0, 0);
+		snprintf(name, sizeof(name), "D%07zX   ", directoryIndex & 0xFFFFFFF);
+		ImageGenerator_WriteEntry(root + (directoryIndex + 1) * 32, name, 0x10, directoryChain[0], 0);
+
+		for(size_t entry = 2 ; entry < filesPerDirectory + 2 && fileCount < options->fileCount ; ++entry)
+		{
+			bool cycle = cycleStride > 0 && cycles < options->cycles && fileCount % cycleStride == 0;
+			bool mismatch = mismatchStride > 0 && mismatches < options->sizeMismatches && fileCount % mismatchStride == mismatchStride - 1;
+			size_t length = 1 + ImageGenerator_Random(&generator) % (2 * averageLength - 1);
+			if(cycle && length < 2)
+				length = 2;
+			if(!ImageGenerator_Allocate(&generator, length))
+			{
+				full = true;
+				break;
+			}
+
+			size_t fileSize = (length - 1) * generator.clusterSize + 1 + ImageGenerator_Random(&generator) % generator.clusterSize;
+			if(cycle)
+			{
+				FileAllocationTable_Write(&(generator.table), generator.clusters[length - 1], generator.clusters[0]);
+				++cycles;
+			}
+			if(mismatch)
+			{
+				fileSize = length * generator.clusterSize + 1;
+				++mismatches;
+			}
+
+			snprintf(name, sizeof(name), "F%07zXDAT", fileCount & 0xFFFFFFF);
+			ImageGenerator_WriteEntry(directory + entry * 32, name, 0x20, generator.clusters[0], fileSize);
+			++fileCount;
+		}
+
+		memcpy(generator.clusters, directoryChain, directoryClusters * sizeof(size_t));
+		ImageGenerator_WriteDirectory(&generator, directory, directoryClusters);
+	}
+
+	for(size_t chain = 0 ; chain < options->lostChains ; ++chain)
+		if(!ImageGenerator_Allocate(&generator, 1 + ImageGenerator_Random(&generator) % 4))
+			break;
+
+	// boot sector
+	uint8_t boot[SECTOR_SIZE] = { 0xEB, 0x3C, 0x90, 'M', 'S', 'D', 'O', 'S', '5', '.', '0' };
+	ImageGenerator_Put(boot, 11, SECTOR_SIZE, 2);
+	ImageGenerator_Put(boot, 13, options->sectorsPerCluster, 1);
+	ImageGenerator_Put(boot, 14, reservedSectors, 2);
+	ImageGenerator_Put(boot, 16, 2, 1);
+	ImageGenerator_Put(boot, 17, rootEntries, 2);
+	ImageGenerator_Put(boot, 19, sectorCount < 65536 ? sectorCount : 0, 2);
+	ImageGenerator_Put(boot, 21, 0xF8, 1);
+	ImageGenerator_Put(boot, 22, type != FAT32 ? tableSectors : 0, 2);
+	ImageGenerator_Put(boot, 32, sectorCount < 65536 ? 0 : sectorCount, 4);
+	if(type == FAT32)
+	{
+		ImageGenerator_Put(boot, 36, tableSectors, 4);
+		ImageGenerator_Put(boot, 44, rootCluster, 4);
+	}
+	boot[510] = 0x55;
+	boot[511] = 0xAA;
+
+	ImageGenerator_WriteAll(&generator, boot, SECTOR_SIZE, 0);
+	for(size_t copy = 0 ; copy < 2 ; ++copy)
+		ImageGenerator_WriteAll(&generator, table, tableSectors * SECTOR_SIZE, (reservedSectors + copy * tableSectors) * SECTOR_SIZE);
+	if(type == FAT32)
+	{
+		memcpy(generator.clusters, rootChain, rootClusters * sizeof(size_t));
+		ImageGenerator_WriteDirectory(&generator, root, rootClusters);
+	}
+	else
+		ImageGenerator_WriteAll(&generator, root, rootEntries * 32, (reservedSectors + 2 * tableSectors) * SECTOR_SIZE);
+
+	ImageGenerator_Release(&generator, buffers, 5);
+	return generator.failed ? -1 : (ssize_t)fileCount;
+}
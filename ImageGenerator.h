@@ -0,0 +1,38 @@
+/** @file ImageGenerator.h
+ *	@author Bandi Enkh-Amgalan
+ *  @brief Declaration of ImageGeneratorOptions struct and the synthetic FAT image generator
+ *
+ *  The generator writes a FAT12, FAT16 or FAT32 image (the type follows from the cluster count, as for real images)
+ *  holding a given number of files, spread over subdirectories of the root directory, with a controllable amount
+ *  of fragmentation and of each kind of damage dos_scandisk looks for. Only the boot sector, tables and directories
+ *  are written; file contents are left as holes of a sparse file, so large images are cheap to generate. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+/* Shape of a generated image */
+typedef struct
+{
+	size_t clusterCount;		/* data clusters, below 4085 for FAT12, below 65525 for FAT16, FAT32 otherwise */
+	size_t sectorsPerCluster;	/* sectors of 512 bytes per cluster */
+	size_t fileCount;			/* files, about half the data area is used by them */
+	size_t fragmentation;		/* percentage of file clusters not following the previous cluster of their file */
+	size_t lostChains;			/* chains of 1 to 4 allocated clusters no directory entry refers to */
+	size_t cycles;				/* files whose last cluster links back to their first cluster */
+	size_t sizeMismatches;		/* files whose directory entry size is one cluster larger than their chain */
+	uint32_t seed;				/* seed of the pseudo-random file lengths and gaps */
+} ImageGeneratorOptions;
+
+/** @brief	Write a synthetic FAT image to a file
+ *
+ *			The file is created or truncated. Files that no longer fit in the data area are left out.
+ *
+ *  @param 	path	image file to write
+ *  @param 	options
+ *  @return number of files written, including damaged ones, or -1 with errno set if a buffer could not be allocated
+ *			or the file could not be created or written */
+ssize_t ImageGenerator_Write(const char* path, ImageGeneratorOptions* options);
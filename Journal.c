@@ -0,0 +1,257 @@
+#define _POSIX_C_SOURCE 200809L
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "Journal.h"
+
+#define JOURNAL_MAGIC "FATJRNL1"
+
+typedef struct
+{
+	char magic[8];
+	uint64_t recordCount;
+	uint64_t payloadLength;
+	uint64_t checksum;
+} JournalHeader;
+
+typedef struct
+{
+	uint64_t offset;
+	uint64_t length;
+} JournalRecord;
+
+/* FNV-1a, enough to tell a torn sidecar file from a complete one */
+static uint64_t Journal_Checksum(const uint8_t* data, size_t length)
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for(size_t index = 0 ; index < length ; ++index)
+	{
+		hash ^= data[index];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+static bool Journal_ReadAll(int fileDescriptor, uint8_t* data, size_t length, size_t offset)
+{
+	while(length > 0)
+	{
+		ssize_t count = pread(fileDescriptor, data, length, offset);
+		if(count == -1 && errno == EINTR)
+			continue;
+		if(count <= 0)
+			return false;
+		data += count;
+		length -= count;
+		offset += count;
+	}
+	return true;
+}
+
+static bool Journal_WriteAll(int fileDescriptor, const uint8_t* data, size_t length, size_t offset)
+{
+	while(length > 0)
+	{
+		ssize_t count = pwrite(fileDescriptor, data, length, offset);
+		if(count == -1 && errno == EINTR)
+			continue;
+		if(count <= 0)
+			return false;
+		data += count;
+		length -= count;
+		offset += count;
+	}
+	return true;
+}
+
+/* syncs the directory holding path, so a newly created or removed sidecar file is durable */
+static void Journal_SyncDirectory(const char* path)
+{
+	char directory[4096] = ".";
+	const char* slash = strrchr(path, '/');
+	if(slash != NULL && (size_t)(slash - path) < sizeof(directory))
+	{
+		size_t length = slash > path ? slash - path : 1;
+		memcpy(directory, path, length);
+		directory[length] = '\0';
+	}
+
+	int fileDescriptor = open(directory, O_RDONLY);
+	if(fileDescriptor != -1)
+	{
+		fsync(fileDescriptor);
+		close(fileDescriptor);
+	}
+}
+
+/* writes the before or after bytes of every record to the image, records must already be validated */
+static bool Journal_WriteRecords(const uint8_t* records, size_t recordsLength, int imageFileDescriptor, bool undo)
+{
+	for(size_t position = 0 ; position < recordsLength ; )
+	{
+		JournalRecord record;
+		memcpy(&record, records + position, sizeof(JournalRecord));
+		const uint8_t* before = records + position + sizeof(JournalRecord);
+		if(!Journal_WriteAll(imageFileDescriptor, undo ? before : before + record.length, record.length, record.offset))
+			return false;
+		position += sizeof(JournalRecord) + 2 * record.length;
+	}
+	return fsync(imageFileDescriptor) == 0;
+}
+
+/* checks that records exactly cover recordsLength bytes and holds recordCount records */
+static bool Journal_ValidateRecords(const uint8_t* records, size_t recordsLength, size_t recordCount)
+{
+	size_t position = 0;
+	for(size_t index = 0 ; index < recordCount ; ++index)
+	{
+		JournalRecord record;
+		if(recordsLength - position < sizeof(JournalRecord))
+			return false;
+		memcpy(&record, records + position, sizeof(JournalRecord));
+		position += sizeof(JournalRecord);
+		if(record.length > (recordsLength - position) / 2)
+			return false;
+		position += 2 * record.length;
+	}
+	return position == recordsLength;
+}
+
+Journal* Journal_Make()
+{
+	Journal* new = calloc(1, sizeof(Journal));
+	assert(new != NULL);
+	return new;
+}
+
+void Journal_Free(Journal* toFree)
+{
+	assert(toFree != NULL);
+	free(toFree->records);
+	free(toFree);
+}
+
+bool Journal_Append(Journal* journal, int imageFileDescriptor, size_t offset, const uint8_t* after, size_t length)
+{
+	assert(journal != NULL);
+	assert(after != NULL || length == 0);
+
+	size_t needed = journal->recordsLength + sizeof(JournalRecord) + 2 * length;
+	if(needed > journal->recordsCapacity)
+	{
+		size_t capacity = journal->recordsCapacity > 0 ? journal->recordsCapacity : 4096;
+		while(capacity < needed)
+			capacity *= 2;
+		journal->records = realloc(journal->records, capacity);
+		assert(journal->records != NULL);
+		journal->recordsCapacity = capacity;
+	}
+
+	uint8_t* position = journal->records + journal->recordsLength;
+	JournalRecord record = { offset, length };
+	memcpy(position, &record, sizeof(JournalRecord));
+	if(!Journal_ReadAll(imageFileDescriptor, position + sizeof(JournalRecord), length, offset))
+		return false;
+	memcpy(position + sizeof(JournalRecord) + length, after, length);
+
+	journal->recordsLength = needed;
+	journal->recordCount += 1;
+	journal->bytesJournaled += length;
+	return true;
+}
+
+bool Journal_Commit(Journal* journal, const char* path, int imageFileDescriptor)
+{
+	assert(journal != NULL);
+	assert(path != NULL);
+
+	JournalHeader header;
+	memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+	header.recordCount = journal->recordCount;
+	header.payloadLength = journal->recordsLength;
+	header.checksum = Journal_Checksum(journal->records, journal->recordsLength);
+
+	// the sidecar file must be durable before the first image byte changes
+	int fileDescriptor = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fileDescriptor == -1)
+		return false;
+	bool written = Journal_WriteAll(fileDescriptor, (const uint8_t*)&header, sizeof(header), 0) &&
+			Journal_WriteAll(fileDescriptor, journal->records, journal->recordsLength, sizeof(header)) &&
+			fsync(fileDescriptor) == 0;
+	close(fileDescriptor);
+	if(!written)
+	{
+		unlink(path);
+		return false;
+	}
+	Journal_SyncDirectory(path);
+
+	// a crash from here on is recovered by Journal_Apply(), the sidecar file is only removed once the image is synced
+	if(!Journal_WriteRecords(journal->records, journal->recordsLength, imageFileDescriptor, false))
+		return false;
+	unlink(path);
+	Journal_SyncDirectory(path);
+	return true;
+}
+
+JournalStatus Journal_Apply(const char* path, int imageFileDescriptor, bool undo)
+{
+	assert(path != NULL);
+
+	int fileDescriptor = open(path, O_RDONLY);
+	if(fileDescriptor == -1)
+		return JournalMissing;
+
+	// a sidecar file that cannot be read may still be a committed journal, so it is kept for a later attempt
+	struct stat fileInfo;
+	uint8_t* contents = NULL;
+	bool readable = fstat(fileDescriptor, &fileInfo) == 0;
+	bool complete = readable && (size_t)fileInfo.st_size >= sizeof(JournalHeader);
+	if(complete)
+	{
+		contents = malloc(fileInfo.st_size);
+		assert(contents != NULL);
+		readable = Journal_ReadAll(fileDescriptor, contents, fileInfo.st_size, 0);
+		complete = readable;
+	}
+	int currentError = errno;
+	close(fileDescriptor);
+	if(!readable)
+	{
+		free(contents);
+		errno = currentError;
+		return JournalFailed;
+	}
+
+	// a sidecar file that does not check out was torn while being written, before the image was touched
+	JournalHeader header;
+	if(complete)
+	{
+		memcpy(&header, contents, sizeof(header));
+		uint8_t* records = contents + sizeof(header);
+		size_t recordsLength = fileInfo.st_size - sizeof(header);
+		complete = memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) == 0 &&
+				header.payloadLength == recordsLength &&
+				header.checksum == Journal_Checksum(records, recordsLength) &&
+				Journal_ValidateRecords(records, recordsLength, header.recordCount);
+	}
+	if(!complete)
+	{
+		free(contents);
+		unlink(path);
+		Journal_SyncDirectory(path);
+		return JournalTorn;
+	}
+
+	bool applied = Journal_WriteRecords(contents + sizeof(header), header.payloadLength, imageFileDescriptor, undo);
+	free(contents);
+	if(!applied)
+		return JournalFailed;
+	unlink(path);
+	Journal_SyncDirectory(path);
+	return JournalApplied;
+}
@@ -0,0 +1,79 @@
+/** @file Journal.h
+ *	@author Bandi Enkh-Amgalan
+ *  @brief Declaration of Journal struct and supporting functions
+ *
+ *  Journal is a write-ahead log of repairs to an image file. Each record holds a byte range of the image
+ *  with its contents before and after the repair. A journal is written and synced to a sidecar file before
+ *  the image is touched, and removed once the image has been written and synced, so a crash at any point
+ *  leaves either an untouched image, or an image that can be rolled forward or back from the sidecar file.
+ *
+ *  The sidecar file is a header (magic, record count, payload length and a checksum of the payload)
+ *  followed by the records, each an offset and a length followed by the before and after bytes, all in host byte order. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Records of a journal in sidecar file layout, built in memory before the journal is committed */
+typedef struct
+{
+	uint8_t* records;
+	size_t recordsLength;
+	size_t recordsCapacity;
+	size_t recordCount;
+	size_t bytesJournaled;
+} Journal;
+
+/* Outcome of applying a sidecar journal file to an image */
+typedef enum
+{
+	JournalMissing,		/* no journal file, nothing to do */
+	JournalTorn,		/* journal file was incomplete, so the image was never touched; the file was removed */
+	JournalApplied,		/* every record was written to the image and synced; the file was removed */
+	JournalFailed		/* reading the journal file or writing the image failed; the file was kept */
+} JournalStatus;
+
+/** @brief	Allocate and initialize an empty Journal on the heap
+ *
+ *			Caller must free the Journal by calling Journal_Free().
+ *
+ *  @return pointer to dynamically allocated Journal struct */
+Journal* Journal_Make();
+
+/** @brief	Free a Journal and its records
+ *
+ *  @param 	journal */
+void Journal_Free(Journal* journal);
+
+/** @brief	Add a record for a range of the image
+ *
+ *			The before bytes are read from the image file, which must not have been written yet.
+ *
+ *  @param 	journal
+ *  @param 	imageFileDescriptor	image file opened for reading
+ *  @param 	offset				offset of the range in the image file
+ *  @param 	after				new contents of the range
+ *  @param 	length				length of the range in bytes
+ *  @return true on success, false if the before bytes could not be read */
+bool Journal_Append(Journal* journal, int imageFileDescriptor, size_t offset, const uint8_t* after, size_t length);
+
+/** @brief	Commit a Journal to an image file
+ *
+ *			Writes and syncs the sidecar journal file, then writes the after bytes of every record to the image
+ *			and syncs it, then removes the sidecar file. If the sidecar file cannot be written the image is left untouched.
+ *
+ *  @param 	journal
+ *  @param 	path				path of the sidecar journal file
+ *  @param 	imageFileDescriptor	image file opened for writing
+ *  @return true if the image was written, false otherwise */
+bool Journal_Commit(Journal* journal, const char* path, int imageFileDescriptor);
+
+/** @brief	Apply a sidecar journal file left behind by an interrupted commit
+ *
+ *  @param 	path				path of the sidecar journal file
+ *  @param 	imageFileDescriptor	image file opened for writing
+ *  @param 	undo				write the before bytes of each record (roll back) instead of the after bytes (replay)
+ *  @return outcome, see JournalStatus */
+JournalStatus Journal_Apply(const char* path, int imageFileDescriptor, bool undo);
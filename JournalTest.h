@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "greatest/greatest.h"
+#include "Journal.h"
+
+#define JOURNAL_TEST_IMAGE "images/journal_test.img"
+#define JOURNAL_TEST_SIDECAR "images/journal_test.img.journal"
+
+static void JournalTest_WriteFile(const char* path, const uint8_t* data, size_t length)
+{
+	FILE* file = fopen(path, "wb");
+	fwrite(data, 1, length, file);
+	fclose(file);
+}
+
+static size_t JournalTest_ReadFile(const char* path, uint8_t* data, size_t capacity)
+{
+	FILE* file = fopen(path, "rb");
+	if(file == NULL)
+		return 0;
+	size_t length = fread(data, 1, capacity, file);
+	fclose(file);
+	return length;
+}
+
+/* leaves a complete sidecar journal behind, as a commit interrupted after syncing it would */
+static void JournalTest_InterruptedCommit(const uint8_t* image, size_t imageLength)
+{
+	uint8_t after[4] = { 0xAA, 0xBB, 0xCC, 0xDD };
+	JournalTest_WriteFile(JOURNAL_TEST_IMAGE, image, imageLength);
+	int fileDescriptor = open(JOURNAL_TEST_IMAGE, O_RDONLY);
+	Journal* journal = Journal_Make();
+	Journal_Append(journal, fileDescriptor, 2, after, 2);
+	Journal_Append(journal, fileDescriptor, 10, after + 2, 2);
+	Journal_Commit(journal, JOURNAL_TEST_SIDECAR, fileDescriptor);
+	Journal_Free(journal);
+	close(fileDescriptor);
+}
+
+TEST Journal_Commit_WritesImageAndRemovesSidecar()
+{
+	uint8_t image[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+	uint8_t after[3] = { 0xAA, 0xBB, 0xCC };
+	JournalTest_WriteFile(JOURNAL_TEST_IMAGE, image, sizeof(image));
+
+	int fileDescriptor = open(JOURNAL_TEST_IMAGE, O_RDWR);
+	Journal* journal = Journal_Make();
+	ASSERT(Journal_Append(journal, fileDescriptor, 4, after, 3));
+	ASSERT_EQ(journal->recordCount, 1);
+	ASSERT_EQ(journal->bytesJournaled, 3);
+	ASSERT(Journal_Commit(journal, JOURNAL_TEST_SIDECAR, fileDescriptor));
+	Journal_Free(journal);
+	close(fileDescriptor);
+
+	uint8_t contents[32];
+	ASSERT_EQ(JournalTest_ReadFile(JOURNAL_TEST_IMAGE, contents, sizeof(contents)), 16);
+	ASSERT_EQ(contents[3], 3);
+	ASSERT_EQ(contents[4], 0xAA);
+	ASSERT_EQ(contents[6], 0xCC);
+	ASSERT_EQ(contents[7], 7);
+	ASSERT_EQ(access(JOURNAL_TEST_SIDECAR, F_OK), -1);
+
+	remove(JOURNAL_TEST_IMAGE);
+	PASS();
+}
+
+TEST Journal_Apply_ReplaysAndRollsBackInterruptedCommit()
+{
+	uint8_t image[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+	uint8_t contents[32];
+
+	// the image was opened read-only, so the commit stops after syncing the sidecar journal
+	JournalTest_InterruptedCommit(image, sizeof(image));
+	ASSERT_EQ(access(JOURNAL_TEST_SIDECAR, F_OK), 0);
+	int fileDescriptor = open(JOURNAL_TEST_IMAGE, O_RDWR);
+	ASSERT_EQ(Journal_Apply(JOURNAL_TEST_SIDECAR, fileDescriptor, false), JournalApplied);
+	close(fileDescriptor);
+	JournalTest_ReadFile(JOURNAL_TEST_IMAGE, contents, sizeof(contents));
+	ASSERT_EQ(contents[2], 0xAA);
+	ASSERT_EQ(contents[3], 0xBB);
+	ASSERT_EQ(contents[10], 0xCC);
+	ASSERT_EQ(contents[11], 0xDD);
+	ASSERT_EQ(access(JOURNAL_TEST_SIDECAR, F_OK), -1);
+
+	// half-written image, rolled back to its original contents
+	JournalTest_InterruptedCommit(image, sizeof(image));
+	memcpy(contents, image, sizeof(image));
+	contents[2] = 0xAA;
+	JournalTest_WriteFile(JOURNAL_TEST_IMAGE, contents, sizeof(image));
+	fileDescriptor = open(JOURNAL_TEST_IMAGE, O_RDWR);
+	ASSERT_EQ(Journal_Apply(JOURNAL_TEST_SIDECAR, fileDescriptor, true), JournalApplied);
+	ASSERT_EQ(Journal_Apply(JOURNAL_TEST_SIDECAR, fileDescriptor, true), JournalMissing);
+	close(fileDescriptor);
+	JournalTest_ReadFile(JOURNAL_TEST_IMAGE, contents, sizeof(contents));
+	ASSERT_EQ(memcmp(contents, image, sizeof(image)), 0);
+
+	remove(JOURNAL_TEST_IMAGE);
+	PASS();
+}
+
+TEST Journal_Apply_DiscardsTornSidecar()
+{
+	uint8_t image[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+	uint8_t contents[256];
+
+	JournalTest_InterruptedCommit(image, sizeof(image));
+	size_t length = JournalTest_ReadFile(JOURNAL_TEST_SIDECAR, contents, sizeof(contents));
+	JournalTest_WriteFile(JOURNAL_TEST_SIDECAR, contents, length - 1);
+
+	int fileDescriptor = open(JOURNAL_TEST_IMAGE, O_RDWR);
+	ASSERT_EQ(Journal_Apply(JOURNAL_TEST_SIDECAR, fileDescriptor, false), JournalTorn);
+	close(fileDescriptor);
+	ASSERT_EQ(access(JOURNAL_TEST_SIDECAR, F_OK), -1);
+	JournalTest_ReadFile(JOURNAL_TEST_IMAGE, contents, sizeof(contents));
+	ASSERT_EQ(memcmp(contents, image, sizeof(image)), 0);
+
+	remove(JOURNAL_TEST_IMAGE);
+	PASS();
+}
+
+TEST Journal_Apply_KeepsSidecarItCannotRead()
+{
+	uint8_t image[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+	uint8_t contents[256];
+	JournalTest_WriteFile(JOURNAL_TEST_IMAGE, image, sizeof(image));
+
+	// a directory opens and has a size, but every read of it fails
+	ASSERT_EQ(mkdir(JOURNAL_TEST_SIDECAR, 0755), 0);
+	int fileDescriptor = open(JOURNAL_TEST_IMAGE, O_RDWR);
+	ASSERT_EQ(Journal_Apply(JOURNAL_TEST_SIDECAR, fileDescriptor, false), JournalFailed);
+	close(fileDescriptor);
+	ASSERT_EQ(access(JOURNAL_TEST_SIDECAR, F_OK), 0);
+	JournalTest_ReadFile(JOURNAL_TEST_IMAGE, contents, sizeof(contents));
+	ASSERT_EQ(memcmp(contents, image, sizeof(image)), 0);
+
+	rmdir(JOURNAL_TEST_SIDECAR);
+	remove(JOURNAL_TEST_IMAGE);
+	PASS();
+}
+
+SUITE(JournalTest)
+{
+	RUN_TEST(Journal_Commit_WritesImageAndRemovesSidecar);
+	RUN_TEST(Journal_Apply_ReplaysAndRollsBackInterruptedCommit);
+	RUN_TEST(Journal_Apply_DiscardsTornSidecar);
+	RUN_TEST(Journal_Apply_KeepsSidecarItCannotRead);
+}
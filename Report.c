@@ -0,0 +1,337 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdarg.h>
+#include <string.h>
+#include "Report.h"
+
+#define REPORT_RECORDS 1024
+#define REPORT_NAME_LENGTH 255
+
+/* JSON key of each value of a record type, NULL past the last value */
+static const char* const Report_Fields[ReportRecordTypeCount][3] =
+{
+	[ReportImage]				= { NULL, NULL, NULL },
+	[ReportError]				= { NULL, NULL, NULL },
+	[ReportCycle]				= { "head", "cluster", "target" },
+	[ReportCrossLink]			= { "head", "cluster", "target" },
+	[ReportBadLink]				= { "head", "cluster", "target" },
+	[ReportCopyMismatch]		= { "copy", "first", "last" },
+	[ReportUnreferenced]		= { "cluster", NULL, NULL },
+	[ReportUnreferencedRange]	= { "first", "last", NULL },
+	[ReportLostFile]			= { "head", "length", NULL },
+	[ReportSizeInconsistency]	= { "entry_size", "chain_size", NULL },
+	[ReportStatistic]			= { "value", NULL, NULL }
+};
+
+/* JSON key of the name of a record type, NULL if it has none */
+static const char* const Report_NameFields[ReportRecordTypeCount] =
+{
+	[ReportImage]				= "path",
+	[ReportError]				= "message",
+	[ReportSizeInconsistency]	= "file",
+	[ReportStatistic]			= "name"
+};
+
+const char* Report_TypeName(ReportRecordType type)
+{
+	static const char* const names[ReportRecordTypeCount] =
+	{
+		"image", "error", "cycle", "cross_link", "bad_link", "copy_mismatch",
+		"unreferenced", "unreferenced_range", "lost_file", "size_inconsistency", "statistic"
+	};
+	assert(type < ReportRecordTypeCount);
+	return names[type];
+}
+
+static void Report_Reserve(Report* report, size_t length)
+{
+	if(report->bufferLength + length <= report->bufferCapacity)
+		return;
+
+	size_t capacity = report->bufferCapacity > 0 ? report->bufferCapacity : 4096;
+	while(capacity < report->bufferLength + length)
+		capacity *= 2;
+	report->buffer = realloc(report->buffer, capacity);
+	assert(report->buffer != NULL);
+	report->bufferCapacity = capacity;
+}
+
+static void Report_Append(Report* report, const char* format, ...)
+{
+	Report_Reserve(report, 64);
+	va_list arguments;
+	va_start(arguments, format);
+	int length = vsnprintf(report->buffer + report->bufferLength, report->bufferCapacity - report->bufferLength, format, arguments);
+	va_end(arguments);
+	assert(length >= 0);
+
+	// formatted output did not fit, grow and format again
+	if(report->bufferLength + length >= report->bufferCapacity)
+	{
+		Report_Reserve(report, length + 1);
+		va_start(arguments, format);
+		vsnprintf(report->buffer + report->bufferLength, report->bufferCapacity - report->bufferLength, format, arguments);
+		va_end(arguments);
+	}
+	report->bufferLength += length;
+}
+
+static void Report_AppendByte(Report* report, uint8_t byte)
+{
+	Report_Reserve(report, 1);
+	report->buffer[report->bufferLength++] = (char)byte;
+}
+
+static void Report_EndLine(Report* report)
+{
+	if(report->lineOpen)
+		Report_AppendByte(report, '\n');
+	report->lineOpen = false;
+}
+
+static const char* Report_Name(Report* report, ReportRecord* record)
+{
+	return record->nameLength > 0 ? report->names + record->nameOffset : "";
+}
+
+static void Report_EncodeText(Report* report, ReportRecord* record)
+{
+	uint64_t* values = record->values;
+	const char* name = Report_Name(report, record);
+	bool unreferenced = record->type == ReportUnreferenced || record->type == ReportUnreferencedRange;
+	if(!unreferenced)
+		Report_EndLine(report);
+
+	switch(record->type)
+	{
+		case ReportImage:
+			Report_Append(report, "Image: %s\n", name);
+			break;
+		case ReportError:
+			Report_Append(report, "dos_scandisk: %s\n", name);
+			break;
+		case ReportCycle:
+			Report_Append(report, "Cycle: %llu %llu %llu\n", (unsigned long long)values[0], (unsigned long long)values[1], (unsigned long long)values[2]);
+			break;
+		case ReportCrossLink:
+			Report_Append(report, "Cross-linked: %llu %llu %llu\n", (unsigned long long)values[0], (unsigned long long)values[1], (unsigned long long)values[2]);
+			break;
+		case ReportBadLink:
+			Report_Append(report, "Bad link: %llu %llu %llu\n", (unsigned long long)values[0], (unsigned long long)values[1], (unsigned long long)values[2]);
+			break;
+		case ReportCopyMismatch:
+			if(values[1] == values[2])
+				Report_Append(report, "FAT copy %llu mismatch: %llu\n", (unsigned long long)values[0], (unsigned long long)values[1]);
+			else
+				Report_Append(report, "FAT copy %llu mismatch: %llu-%llu\n", (unsigned long long)values[0], (unsigned long long)values[1], (unsigned long long)values[2]);
+			break;
+		case ReportUnreferenced:
+		case ReportUnreferencedRange:
+			if(!report->lineOpen)
+				Report_Append(report, "Unreferenced:");
+			report->lineOpen = true;
+			if(record->type == ReportUnreferenced || values[0] == values[1])
+				Report_Append(report, " %llu", (unsigned long long)values[0]);
+			else
+				Report_Append(report, " %llu-%llu", (unsigned long long)values[0], (unsigned long long)values[1]);
+			break;
+		case ReportLostFile:
+			Report_Append(report, "Lost file: %llu %llu\n", (unsigned long long)values[0], (unsigned long long)values[1]);
+			break;
+		case ReportSizeInconsistency:
+			Report_Append(report, "%s %llu %llu\n", name, (unsigned long long)values[0], (unsigned long long)values[1]);
+			break;
+		case ReportStatistic:
+			Report_Append(report, "Statistic: %s %llu\n", name, (unsigned long long)values[0]);
+			break;
+		default:
+			assert(false);
+	}
+}
+
+static void Report_EncodeJSONString(Report* report, const char* string)
+{
+	Report_AppendByte(report, '"');
+	for( ; *string != '\0' ; ++string)
+	{
+		uint8_t character = (uint8_t)*string;
+		if(character == '"' || character == '\\')
+		{
+			Report_AppendByte(report, '\\');
+			Report_AppendByte(report, character);
+		}
+		else if(character < 0x20)
+			Report_Append(report, "\\u%04x", character);
+		else
+			Report_AppendByte(report, character);
+	}
+	Report_AppendByte(report, '"');
+}
+
+static void Report_EncodeJSONLines(Report* report, ReportRecord* record)
+{
+	Report_Append(report, "{\"type\":\"%s\"", Report_TypeName(record->type));
+	const char* nameField = Report_NameFields[record->type];
+	if(nameField != NULL)
+	{
+		Report_Append(report, ",\"%s\":", nameField);
+		Report_EncodeJSONString(report, Report_Name(report, record));
+	}
+	for(size_t value = 0 ; value < 3 && Report_Fields[record->type][value] != NULL ; ++value)
+		Report_Append(report, ",\"%s\":%llu", Report_Fields[record->type][value], (unsigned long long)record->values[value]);
+	Report_Append(report, "}\n");
+}
+
+static void Report_EncodeBinary(Report* report, ReportRecord* record)
+{
+	Report_AppendByte(report, (uint8_t)record->type);
+	if(Report_NameFields[record->type] != NULL)
+	{
+		size_t length = record->nameLength;
+		Report_AppendByte(report, (uint8_t)length);
+		Report_Reserve(report, length);
+		memcpy(report->buffer + report->bufferLength, Report_Name(report, record), length);
+		report->bufferLength += length;
+	}
+	for(size_t value = 0 ; value < 3 && Report_Fields[record->type][value] != NULL ; ++value)
+	{
+		// unsigned LEB128, 7 bits per byte with the high bit set on all but the last byte
+		uint64_t number = record->values[value];
+		do
+		{
+			uint8_t byte = number & 0x7F;
+			number >>= 7;
+			Report_AppendByte(report, number != 0 ? byte | 0x80 : byte);
+		} while(number != 0);
+	}
+}
+
+/* encodes pending records and writes them in one call */
+static void Report_Write(Report* report, bool endLine)
+{
+	for(size_t index = 0 ; index < report->recordsLength ; ++index)
+	{
+		ReportRecord* record = report->records + index;
+		switch(report->format)
+		{
+			case ReportText:
+				Report_EncodeText(report, record);
+				break;
+			case ReportJSONLines:
+				Report_EncodeJSONLines(report, record);
+				break;
+			case ReportBinary:
+				Report_EncodeBinary(report, record);
+				break;
+		}
+	}
+	if(endLine)
+		Report_EndLine(report);
+
+	if(report->bufferLength > 0)
+		fwrite(report->buffer, 1, report->bufferLength, report->output);
+	report->recordsWritten += report->recordsLength;
+	report->bytesWritten += report->bufferLength;
+	report->recordsLength = 0;
+	report->bufferLength = 0;
+	report->namesLength = 0;
+}
+
+static ReportRecord* Report_NewRecord(Report* report, ReportRecordType type)
+{
+	assert(report != NULL);
+	assert(type < ReportRecordTypeCount);
+
+	if(report->recordsLength == REPORT_RECORDS)
+		Report_Write(report, false);
+	if(report->recordsLength == report->recordsCapacity)
+	{
+		size_t capacity = report->recordsCapacity > 0 ? 2 * report->recordsCapacity : 64;
+		report->records = realloc(report->records, capacity * sizeof(ReportRecord));
+		assert(report->records != NULL);
+		report->recordsCapacity = capacity;
+	}
+
+	ReportRecord* record = report->records + report->recordsLength++;
+	record->type = type;
+	return record;
+}
+
+Report* Report_Make(FILE* output, ReportFormat format)
+{
+	assert(output != NULL);
+
+	Report* new = calloc(1, sizeof(Report));
+	assert(new != NULL);
+	new->output = output;
+	new->format = format;
+	return new;
+}
+
+void Report_Free(Report* toFree)
+{
+	assert(toFree != NULL);
+	Report_Flush(toFree);
+	free(toFree->records);
+	free(toFree->names);
+	free(toFree->buffer);
+	free(toFree);
+}
+
+void Report_Add(Report* report, ReportRecordType type, uint64_t first, uint64_t second, uint64_t third)
+{
+	ReportRecord* record = Report_NewRecord(report, type);
+	record->values[0] = first;
+	record->values[1] = second;
+	record->values[2] = third;
+	record->nameOffset = 0;
+	record->nameLength = 0;
+}
+
+void Report_AddNamed(Report* report, ReportRecordType type, const char* name, uint64_t first, uint64_t second)
+{
+	assert(name != NULL);
+
+	ReportRecord* record = Report_NewRecord(report, type);
+	record->values[0] = first;
+	record->values[1] = second;
+	record->values[2] = 0;
+
+	// names are copied behind the previous ones, and dropped with the records once they are written
+	size_t length = strnlen(name, REPORT_NAME_LENGTH);
+	if(report->namesLength + length + 1 > report->namesCapacity)
+	{
+		size_t capacity = report->namesCapacity > 0 ? report->namesCapacity : 4096;
+		while(capacity < report->namesLength + length + 1)
+			capacity *= 2;
+		report->names = realloc(report->names, capacity);
+		assert(report->names != NULL);
+		report->namesCapacity = capacity;
+	}
+	memcpy(report->names + report->namesLength, name, length);
+	report->names[report->namesLength + length] = '\0';
+	record->nameOffset = report->namesLength;
+	record->nameLength = length;
+	report->namesLength += length + 1;
+}
+
+void Report_AddError(Report* report, const char* context, int error)
+{
+	// strerror shares one buffer between threads, strerror_r writes into ours
+	char description[128];
+	if(strerror_r(error, description, sizeof(description)) != 0)
+		snprintf(description, sizeof(description), "error %d", error);
+
+	char message[512];
+	if(context != NULL)
+		snprintf(message, sizeof(message), "%s: %s", context, description);
+	else
+		snprintf(message, sizeof(message), "%s", description);
+	Report_AddNamed(report, ReportError, message, 0, 0);
+}
+
+void Report_Flush(Report* report)
+{
+	assert(report != NULL);
+	Report_Write(report, true);
+}
@@ -0,0 +1,132 @@
+/** @file Report.h
+ *	@author Bandi Enkh-Amgalan
+ *  @brief Declaration of Report struct and supporting functions
+ *
+ *  Report is a sink for the findings of a file system check. Findings are added as typed records to a
+ *  reusable buffer, and encoded by one of several emitters into a reusable byte buffer that is written to the
+ *  output stream in one call when the record buffer is full or the report is flushed.
+ *
+ *  The text emitter produces the classic dos_scandisk lines. The JSON Lines emitter writes one object per record,
+ *  with a "type" key naming the record. The binary emitter writes each record as its type byte, followed by its
+ *  numbers as unsigned LEB128 and its name (if any) as a length byte followed by the characters. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Kind of finding held by a record, and the fields of ReportRecord it uses */
+typedef enum
+{
+	ReportImage,				/* name: path of the image the following records belong to */
+	ReportError,				/* name: error message */
+	ReportCycle,				/* values: head, cluster, target */
+	ReportCrossLink,			/* values: head, cluster, target */
+	ReportBadLink,				/* values: head, cluster, target */
+	ReportCopyMismatch,			/* values: copy (1-based), first entry, last entry */
+	ReportUnreferenced,			/* values: cluster */
+	ReportUnreferencedRange,	/* values: first cluster, last cluster */
+	ReportLostFile,				/* values: head cluster, length in clusters */
+	ReportSizeInconsistency,	/* name: file name, values: size in directory entry, size of cluster chain */
+	ReportStatistic,			/* name: timer or counter, values: its value */
+	ReportRecordTypeCount
+} ReportRecordType;
+
+/* One finding, its name (if any) is kept in Report::names so records stay small */
+typedef struct
+{
+	ReportRecordType type;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint64_t values[3];
+} ReportRecord;
+
+/* Encoding written by a Report */
+typedef enum
+{
+	ReportText,
+	ReportJSONLines,
+	ReportBinary
+} ReportFormat;
+
+/* Sink of records, and the emitter writing them to a stream */
+typedef struct
+{
+	ReportFormat format;
+	FILE* output;
+
+	/* Records added since the last write */
+	ReportRecord* records;
+	size_t recordsLength;
+	size_t recordsCapacity;
+
+	/* Null-terminated names of the records added since the last write, one after another */
+	char* names;
+	size_t namesLength;
+	size_t namesCapacity;
+
+	/* Encoded bytes of one write */
+	char* buffer;
+	size_t bufferLength;
+	size_t bufferCapacity;
+
+	/* Text emitter is in the middle of an "Unreferenced:" line, which is ended by any other record or a flush */
+	bool lineOpen;
+
+	size_t recordsWritten;
+	size_t bytesWritten;
+} Report;
+
+/** @brief	Allocate and initialize an empty Report on the heap
+ *
+ *			Caller must free the Report by calling Report_Free().
+ *
+ *  @param 	output	stream records are written to
+ *  @param 	format	encoding of records
+ *  @return pointer to dynamically allocated Report struct */
+Report* Report_Make(FILE* output, ReportFormat format);
+
+/** @brief	Flush and free a Report
+ *
+ *  @param 	report */
+void Report_Free(Report* report);
+
+/** @brief	Add a record with up to three numbers and no name
+ *
+ *			The record is written once the record buffer is full, or by Report_Flush().
+ *
+ *  @param 	report
+ *  @param 	type
+ *  @param 	first, second, third	values of the record, unused values are ignored */
+void Report_Add(Report* report, ReportRecordType type, uint64_t first, uint64_t second, uint64_t third);
+
+/** @brief	Add a record with a name and up to two numbers
+ *
+ *  @param 	report
+ *  @param 	type
+ *  @param 	name	truncated to 255 characters
+ *  @param 	first, second	values of the record, unused values are ignored */
+void Report_AddNamed(Report* report, ReportRecordType type, const char* name, uint64_t first, uint64_t second);
+
+/** @brief	Add an error record describing a system error
+ *
+ *			The description comes from strerror_r, so reports on different threads may call this concurrently;
+ *			one Report must not be shared between threads.
+ *
+ *  @param 	report
+ *  @param 	context	what failed, prefixed to the description of the error, or NULL for the description alone
+ *  @param 	error	errno value */
+void Report_AddError(Report* report, const char* context, int error);
+
+/** @brief	Write every pending record to the output stream in one write, ending any open text line
+ *
+ *  @param 	report */
+void Report_Flush(Report* report);
+
+/** @brief	Name of a record type, as used in JSON Lines output
+ *
+ *  @param 	type
+ *  @return name of type */
+const char* Report_TypeName(ReportRecordType type);
@@ -0,0 +1,158 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "greatest/greatest.h"
+#include "Report.h"
+
+/* writes a few records of every kind with the given format, returns the number of bytes written to buffer */
+static size_t ReportTest_Write(ReportFormat format, char* buffer, size_t capacity)
+{
+	FILE* output = tmpfile();
+	Report* report = Report_Make(output, format);
+	Report_Add(report, ReportCycle, 2, 5, 3);
+	Report_Add(report, ReportCopyMismatch, 2, 300, 300);
+	Report_Add(report, ReportCopyMismatch, 2, 339, 340);
+	Report_Add(report, ReportUnreferenced, 7, 0, 0);
+	Report_Add(report, ReportUnreferenced, 300, 0, 0);
+	Report_Add(report, ReportLostFile, 7, 2, 0);
+	Report_AddNamed(report, ReportSizeInconsistency, "B.DAT", 100, 1536);
+	Report_Add(report, ReportUnreferencedRange, 7, 10, 0);
+	Report_Add(report, ReportUnreferencedRange, 12, 12, 0);
+	Report_Free(report);
+
+	rewind(output);
+	size_t length = fread(buffer, 1, capacity, output);
+	fclose(output);
+	return length;
+}
+
+TEST Report_Flush_TextMatchesClassicLines()
+{
+	char buffer[1024];
+	size_t length = ReportTest_Write(ReportText, buffer, sizeof(buffer));
+	const char* expected =
+		"Cycle: 2 5 3\n"
+		"FAT copy 2 mismatch: 300\n"
+		"FAT copy 2 mismatch: 339-340\n"
+		"Unreferenced: 7 300\n"
+		"Lost file: 7 2\n"
+		"B.DAT 100 1536\n"
+		"Unreferenced: 7-10 12\n";
+	ASSERT_EQ(length, strlen(expected));
+	ASSERT_EQ(memcmp(buffer, expected, length), 0);
+	PASS();
+}
+
+TEST Report_Flush_JSONLinesHasOneObjectPerRecord()
+{
+	char buffer[2048];
+	size_t length = ReportTest_Write(ReportJSONLines, buffer, sizeof(buffer));
+	buffer[length] = '\0';
+	ASSERT(strstr(buffer, "{\"type\":\"cycle\",\"head\":2,\"cluster\":5,\"target\":3}\n") == buffer);
+	ASSERT(strstr(buffer, "{\"type\":\"size_inconsistency\",\"file\":\"B.DAT\",\"entry_size\":100,\"chain_size\":1536}\n") != NULL);
+
+	size_t lines = 0;
+	for(size_t index = 0 ; index < length ; ++index)
+		lines += buffer[index] == '\n';
+	ASSERT_EQ(lines, 9);
+	PASS();
+}
+
+TEST Report_Flush_BinaryUsesTypeBytesAndLEB128()
+{
+	char buffer[1024];
+	ReportTest_Write(ReportBinary, buffer, sizeof(buffer));
+
+	// cycle: type, then three one-byte numbers
+	uint8_t* bytes = (uint8_t*)buffer;
+	ASSERT_EQ(bytes[0], ReportCycle);
+	ASSERT_EQ(bytes[1], 2); ASSERT_EQ(bytes[2], 5); ASSERT_EQ(bytes[3], 3);
+
+	// copy mismatch: 300 takes two bytes, 0xAC 0x02
+	ASSERT_EQ(bytes[4], ReportCopyMismatch);
+	ASSERT_EQ(bytes[5], 2); ASSERT_EQ(bytes[6], 0xAC); ASSERT_EQ(bytes[7], 0x02);
+	PASS();
+}
+
+TEST Report_Add_WritesInChunksOfFullBuffers()
+{
+	FILE* output = tmpfile();
+	Report* report = Report_Make(output, ReportText);
+	for(size_t cluster = 0 ; cluster < 5000 ; ++cluster)
+		Report_Add(report, ReportUnreferenced, cluster, 0, 0);
+	ASSERT(report->recordsWritten >= 4096);
+	ASSERT(report->recordsLength < 1024);
+	Report_Flush(report);
+	ASSERT_EQ(report->recordsWritten, 5000);
+
+	// one line across all chunks
+	rewind(output);
+	size_t lines = 0;
+	int character;
+	while((character = fgetc(output)) != EOF)
+		lines += character == '\n';
+	ASSERT_EQ(lines, 1);
+
+	Report_Free(report);
+	fclose(output);
+	PASS();
+}
+
+TEST Report_AddNamed_KeepsNamesAcrossChunks()
+{
+	// names live beside the records, so a record is a few words however long its name
+	ASSERT(sizeof(ReportRecord) <= 48);
+
+	FILE* output = tmpfile();
+	Report* report = Report_Make(output, ReportText);
+	char name[300];
+	for(size_t file = 0 ; file < 3000 ; ++file)
+	{
+		snprintf(name, sizeof(name), "FILE%zu.DAT", file);
+		Report_AddNamed(report, ReportSizeInconsistency, name, file, 512);
+	}
+	memset(name, 'A', sizeof(name) - 1);
+	name[sizeof(name) - 1] = '\0';
+	Report_AddNamed(report, ReportError, name, 0, 0);
+	Report_Free(report);
+
+	char line[512];
+	rewind(output);
+	for(size_t file = 0 ; file < 3000 ; ++file)
+	{
+		char expected[64];
+		snprintf(expected, sizeof(expected), "FILE%zu.DAT %zu 512\n", file, file);
+		ASSERT(fgets(line, sizeof(line), output) != NULL);
+		ASSERT_STR_EQ(line, expected);
+	}
+	ASSERT(fgets(line, sizeof(line), output) != NULL);
+	ASSERT_EQ(strlen(line), strlen("dos_scandisk: \n") + 255);
+	fclose(output);
+	PASS();
+}
+
+TEST Report_AddError_DescribesSystemErrors()
+{
+	FILE* output = tmpfile();
+	Report* report = Report_Make(output, ReportText);
+	Report_AddError(report, "cannot open image", ENOENT);
+	Report_AddError(report, NULL, EACCES);
+	Report_Free(report);
+
+	char buffer[256] = { 0 };
+	rewind(output);
+	ASSERT(fread(buffer, 1, sizeof(buffer) - 1, output) > 0);
+	ASSERT_STR_EQ(buffer, "dos_scandisk: cannot open image: No such file or directory\ndos_scandisk: Permission denied\n");
+	fclose(output);
+	PASS();
+}
+
+SUITE(ReportTest)
+{
+	RUN_TEST(Report_Flush_TextMatchesClassicLines);
+	RUN_TEST(Report_Flush_JSONLinesHasOneObjectPerRecord);
+	RUN_TEST(Report_Flush_BinaryUsesTypeBytesAndLEB128);
+	RUN_TEST(Report_Add_WritesInChunksOfFullBuffers);
+	RUN_TEST(Report_AddNamed_KeepsNamesAcrossChunks);
+	RUN_TEST(Report_AddError_DescribesSystemErrors);
+}
@@ -0,0 +1,140 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "ThreadPool.h"
+
+typedef struct
+{
+	ThreadPool* pool;
+	size_t worker;
+} ThreadPoolWorker;
+
+/* takes the next index from the front of a worker's own queue */
+static bool ThreadPool_Pop(ThreadPoolQueue* queue, size_t* index)
+{
+	pthread_mutex_lock(&(queue->lock));
+	bool found = queue->first < queue->end;
+	if(found)
+		*index = queue->tasks[queue->first++];
+	pthread_mutex_unlock(&(queue->lock));
+	return found;
+}
+
+/* takes the last index from the back of another worker's queue, the one its owner would reach last */
+static bool ThreadPool_Steal(ThreadPoolQueue* queue, size_t* index)
+{
+	pthread_mutex_lock(&(queue->lock));
+	bool found = queue->first < queue->end;
+	if(found)
+		*index = queue->tasks[--queue->end];
+	pthread_mutex_unlock(&(queue->lock));
+	return found;
+}
+
+static void* ThreadPool_Work(void* argument)
+{
+	ThreadPool* pool = ((ThreadPoolWorker*)argument)->pool;
+	size_t worker = ((ThreadPoolWorker*)argument)->worker;
+
+	// no tasks are added during a run, so a worker is done once every queue is empty
+	size_t index;
+	size_t stolen = 0;
+	while(true)
+	{
+		if(ThreadPool_Pop(pool->queues + worker, &index))
+		{
+			pool->task(pool->context, index);
+			continue;
+		}
+
+		bool found = false;
+		for(size_t offset = 1 ; offset < pool->workerCount && !found ; ++offset)
+			found = ThreadPool_Steal(pool->queues + (worker + offset) % pool->workerCount, &index);
+		if(!found)
+			break;
+		++stolen;
+		pool->task(pool->context, index);
+	}
+
+	pthread_mutex_lock(&(pool->statsLock));
+	pool->stolen += stolen;
+	pthread_mutex_unlock(&(pool->statsLock));
+	free(argument);
+	return NULL;
+}
+
+ThreadPool* ThreadPool_Make(size_t workerCount)
+{
+	if(workerCount == 0)
+	{
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		workerCount = online > 0 ? online : 1;
+	}
+
+	ThreadPool* new = calloc(1, sizeof(ThreadPool));
+	assert(new != NULL);
+	new->workerCount = workerCount;
+	new->threads = calloc(workerCount, sizeof(pthread_t));
+	new->queues = calloc(workerCount, sizeof(ThreadPoolQueue));
+	assert(new->threads != NULL && new->queues != NULL);
+	for(size_t worker = 0 ; worker < workerCount ; ++worker)
+		pthread_mutex_init(&(new->queues[worker].lock), NULL);
+	pthread_mutex_init(&(new->statsLock), NULL);
+
+	return new;
+}
+
+void ThreadPool_Free(ThreadPool* toFree)
+{
+	assert(toFree != NULL);
+	for(size_t worker = 0 ; worker < toFree->workerCount ; ++worker)
+	{
+		pthread_mutex_destroy(&(toFree->queues[worker].lock));
+		free(toFree->queues[worker].tasks);
+	}
+	pthread_mutex_destroy(&(toFree->statsLock));
+	free(toFree->queues);
+	free(toFree->threads);
+	free(toFree);
+}
+
+void ThreadPool_Start(ThreadPool* pool, size_t count, ThreadPoolTask task, void* context)
+{
+	assert(pool != NULL);
+	assert(task != NULL);
+
+	pool->task = task;
+	pool->context = context;
+	pool->stolen = 0;
+
+	// worker w gets indices w, w + workers, w + 2 * workers, ... so all workers progress through the indices together
+	for(size_t worker = 0 ; worker < pool->workerCount ; ++worker)
+	{
+		ThreadPoolQueue* queue = pool->queues + worker;
+		free(queue->tasks);
+		queue->tasks = malloc((count / pool->workerCount + 1) * sizeof(size_t));
+		assert(queue->tasks != NULL);
+		queue->first = 0;
+		queue->end = 0;
+		for(size_t index = worker ; index < count ; index += pool->workerCount)
+			queue->tasks[queue->end++] = index;
+	}
+
+	for(size_t worker = 0 ; worker < pool->workerCount ; ++worker)
+	{
+		ThreadPoolWorker* argument = malloc(sizeof(ThreadPoolWorker));
+		assert(argument != NULL);
+		argument->pool = pool;
+		argument->worker = worker;
+		int error = pthread_create(pool->threads + worker, NULL, ThreadPool_Work, argument);
+		assert(error == 0);
+	}
+}
+
+void ThreadPool_Wait(ThreadPool* pool)
+{
+	assert(pool != NULL);
+	for(size_t worker = 0 ; worker < pool->workerCount ; ++worker)
+		pthread_join(pool->threads[worker], NULL);
+}
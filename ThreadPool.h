@@ -0,0 +1,69 @@
+/** @file ThreadPool.h
+ *	@author Bandi Enkh-Amgalan
+ *  @brief Declaration of ThreadPool struct and supporting functions
+ *
+ *  ThreadPool runs a task for every index in [0, count) on a fixed number of threads. Indices are dealt out
+ *  round-robin to one queue per worker; each worker takes indices from the front of its own queue, in ascending
+ *  order, and once it runs dry steals from the back of the other queues, so uneven tasks (e.g. images of very
+ *  different sizes) keep every worker busy. */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/* Task run for one index, from any worker thread */
+typedef void (*ThreadPoolTask)(void* context, size_t index);
+
+/* Indices [first, end) of tasks[] not taken yet by a worker */
+typedef struct
+{
+	pthread_mutex_t lock;
+	size_t* tasks;
+	size_t first;
+	size_t end;
+} ThreadPoolQueue;
+
+/* Worker threads of a run, and their queues */
+typedef struct
+{
+	size_t workerCount;
+	pthread_t* threads;
+	ThreadPoolQueue* queues;
+
+	ThreadPoolTask task;
+	void* context;
+
+	/* Number of tasks a worker took from another worker's queue during the last run */
+	size_t stolen;
+	pthread_mutex_t statsLock;
+} ThreadPool;
+
+/** @brief	Allocate and initialize a ThreadPool on the heap
+ *
+ *			Caller must free the ThreadPool by calling ThreadPool_Free().
+ *
+ *  @param 	workerCount	number of threads, 0 for one thread per online CPU
+ *  @return pointer to dynamically allocated ThreadPool struct */
+ThreadPool* ThreadPool_Make(size_t workerCount);
+
+/** @brief	Free a ThreadPool, which must not be running
+ *
+ *  @param 	pool */
+void ThreadPool_Free(ThreadPool* pool);
+
+/** @brief	Start running task for every index in [0, count) and return without waiting
+ *
+ *			The caller thread is free to consume results as tasks complete, and must call ThreadPool_Wait()
+ *			before starting another run. Tasks are taken roughly in ascending index order.
+ *
+ *  @param 	pool
+ *  @param 	count	number of tasks
+ *  @param 	task	function called once for each index
+ *  @param 	context	passed to every call of task */
+void ThreadPool_Start(ThreadPool* pool, size_t count, ThreadPoolTask task, void* context);
+
+/** @brief	Wait until every task of the current run has completed
+ *
+ *  @param 	pool */
+void ThreadPool_Wait(ThreadPool* pool);
@@ -0,0 +1,111 @@
+#include <stdint.h>
+#include "greatest/greatest.h"
+#include "ThreadPool.h"
+
+#define THREAD_POOL_TEST_TASKS 1000
+
+/* Per-index run counts, every index must be run exactly once */
+typedef struct
+{
+	pthread_mutex_t lock;
+	size_t runs[THREAD_POOL_TEST_TASKS];
+} ThreadPoolTestCounts;
+
+static void ThreadPoolTest_Count(void* context, size_t index)
+{
+	ThreadPoolTestCounts* counts = context;
+
+	// tasks owned by worker 0 are much slower, so the other workers run out early and steal them
+	if(index % 4 == 0)
+	{
+		volatile size_t spin = 0;
+		for(size_t step = 0 ; step < 20000 ; ++step)
+			spin += step;
+	}
+
+	pthread_mutex_lock(&(counts->lock));
+	counts->runs[index] += 1;
+	pthread_mutex_unlock(&(counts->lock));
+}
+
+TEST ThreadPool_Start_RunsEveryIndexOnce()
+{
+	ThreadPoolTestCounts counts = { PTHREAD_MUTEX_INITIALIZER, { 0 } };
+	ThreadPool* pool = ThreadPool_Make(4);
+	ASSERT_EQ(pool->workerCount, 4);
+
+	ThreadPool_Start(pool, THREAD_POOL_TEST_TASKS, ThreadPoolTest_Count, &counts);
+	ThreadPool_Wait(pool);
+	for(size_t index = 0 ; index < THREAD_POOL_TEST_TASKS ; ++index)
+		ASSERT_EQ(counts.runs[index], 1);
+	ASSERT(pool->stolen < THREAD_POOL_TEST_TASKS);
+
+	// pools can be reused, and runs with fewer tasks than workers leave some queues empty
+	ThreadPool_Start(pool, 3, ThreadPoolTest_Count, &counts);
+	ThreadPool_Wait(pool);
+	ASSERT_EQ(counts.runs[0], 2);
+	ASSERT_EQ(counts.runs[2], 2);
+	ASSERT_EQ(counts.runs[3], 1);
+
+	ThreadPool_Free(pool);
+	PASS();
+}
+
+#define THREAD_POOL_STEAL_TASKS 8
+
+/* Tasks of a run where index 0 waits until every other index has run */
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t othersDone;
+	size_t others;
+} ThreadPoolTestBlocker;
+
+static void ThreadPoolTest_Block(void* context, size_t index)
+{
+	ThreadPoolTestBlocker* blocker = context;
+	pthread_mutex_lock(&(blocker->lock));
+	if(index == 0)
+	{
+		while(blocker->others < THREAD_POOL_STEAL_TASKS - 1)
+			pthread_cond_wait(&(blocker->othersDone), &(blocker->lock));
+	}
+	else
+	{
+		blocker->others += 1;
+		pthread_cond_broadcast(&(blocker->othersDone));
+	}
+	pthread_mutex_unlock(&(blocker->lock));
+}
+
+TEST ThreadPool_Start_IdleWorkersStealFromABlockedQueue()
+{
+	ThreadPoolTestBlocker blocker = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0 };
+	ThreadPool* pool = ThreadPool_Make(2);
+
+	// worker 0 owns 0, 2, 4, 6 and is stuck on 0 until they have all run, which only worker 1 can do by stealing
+	ThreadPool_Start(pool, THREAD_POOL_STEAL_TASKS, ThreadPoolTest_Block, &blocker);
+	ThreadPool_Wait(pool);
+	ASSERT_EQ(blocker.others, THREAD_POOL_STEAL_TASKS - 1);
+	ASSERT(pool->stolen >= 3);
+
+	ThreadPool_Free(pool);
+	pthread_cond_destroy(&(blocker.othersDone));
+	pthread_mutex_destroy(&(blocker.lock));
+	PASS();
+}
+
+TEST ThreadPool_Make_ZeroWorkersUsesOnlineCPUs()
+{
+	ThreadPool* pool = ThreadPool_Make(0);
+	ASSERT(pool->workerCount >= 1);
+	ThreadPool_Free(pool);
+	PASS();
+}
+
+SUITE(ThreadPoolTest)
+{
+	RUN_TEST(ThreadPool_Start_RunsEveryIndexOnce);
+	RUN_TEST(ThreadPool_Start_IdleWorkersStealFromABlockedQueue);
+	RUN_TEST(ThreadPool_Make_ZeroWorkersUsesOnlineCPUs);
+}
@@ -0,0 +1,488 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "FATImageInternal.h"
+#include "FileAllocationTable.h"
+#include "Helpers.h"
+#include "ImageGenerator.h"
+
+#define DECODE_ENTRIES (1 << 20)
+#define DECODE_ROUNDS 200
+#define LOOKUP_ENTRIES (1 << 24)
+#define LOOKUP_CHAIN 100
+
+double Benchmark_Now()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* heap allocations of the whole process, counted by wrapping the allocator at link time (see the bench target) */
+static size_t Benchmark_Allocations;
+static size_t Benchmark_AllocatedBytes;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+	__atomic_add_fetch(&Benchmark_Allocations, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&Benchmark_AllocatedBytes, size, __ATOMIC_RELAXED);
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+	__atomic_add_fetch(&Benchmark_Allocations, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&Benchmark_AllocatedBytes, count * size, __ATOMIC_RELAXED);
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+	__atomic_add_fetch(&Benchmark_Allocations, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&Benchmark_AllocatedBytes, size, __ATOMIC_RELAXED);
+	return __real_realloc(pointer, size);
+}
+
+/* Start of a measured phase */
+typedef struct
+{
+	double time;
+	size_t allocations;
+	size_t allocatedBytes;
+} BenchmarkMark;
+
+/* peak resident set size in kB since the last Benchmark_ResetPeakRSS(), -1 without /proc */
+long Benchmark_PeakRSS()
+{
+	FILE* status = fopen("/proc/self/status", "r");
+	if(status == NULL)
+		return -1;
+
+	char line[256];
+	long peak = -1;
+	while(fgets(line, sizeof(line), status) != NULL)
+		if(strncmp(line, "VmHWM:", 6) == 0)
+			peak = strtol(line + 6, NULL, 10);
+	fclose(status);
+	return peak;
+}
+
+/* lowers the process high-water mark to the current resident set size, so the next VmHWM covers one phase only */
+void Benchmark_ResetPeakRSS()
+{
+	FILE* clearRefs = fopen("/proc/self/clear_refs", "w");
+	if(clearRefs == NULL)
+		return;
+	fputs("5", clearRefs);
+	fclose(clearRefs);
+}
+
+BenchmarkMark Benchmark_Mark()
+{
+	BenchmarkMark mark = { Benchmark_Now(), __atomic_load_n(&Benchmark_Allocations, __ATOMIC_RELAXED), __atomic_load_n(&Benchmark_AllocatedBytes, __ATOMIC_RELAXED) };
+	return mark;
+}
+
+/* prints the phase started at mark and starts the next one */
+void Benchmark_EndPhase(const char* image, size_t clusters, const char* phase, BenchmarkMark* mark)
+{
+	BenchmarkMark end = Benchmark_Mark();
+	long peak = Benchmark_PeakRSS();
+	double elapsed = end.time - mark->time;
+	printf("phase image=%s clusters=%zd phase=%s seconds=%.6f clusters_per_second=%.0f allocations=%zd allocated_bytes=%zd peak_rss_kb=%ld\n",
+			image, clusters, phase, elapsed, elapsed > 0 ? clusters / elapsed : 0, end.allocations - mark->allocations,
+			end.allocatedBytes - mark->allocatedBytes, peak);
+	Benchmark_ResetPeakRSS();
+	*mark = Benchmark_Mark();
+}
+
+/* true if name was given on the command line, or no benchmark was */
+bool Benchmark_Selected(int argc, char** argv, const char* name)
+{
+	bool any = false;
+	for(int index = 1 ; index < argc ; ++index)
+	{
+		if(strchr(argv[index], '=') != NULL)
+			continue;
+		any = true;
+		if(strcmp(argv[index], name) == 0)
+			return true;
+	}
+	return !any;
+}
+
+void Benchmark_Decode()
+{
+	size_t sourceLength = DECODE_ENTRIES * 3 / 2;
+	uint8_t* source = malloc(sourceLength);
+	uint16_t* destination = malloc(DECODE_ENTRIES * sizeof(uint16_t));
+	uint32_t* wideDestination = malloc(DECODE_ENTRIES * sizeof(uint32_t));
+	if(source == NULL || destination == NULL || wideDestination == NULL)
+	{
+		printf("benchmark: out of memory\n");
+		exit(1);
+	}
+
+	for(size_t index = 0 ; index < sourceLength ; ++index)
+		source[index] = (uint8_t)(index * 167 + 13);
+
+	for(int kernel = DecodeKernelScalar ; kernel < DecodeKernelCount ; ++kernel)
+	{
+		if(!DecodeKernel_IsSupported(kernel))
+		{
+			printf("decode kernel=%s unsupported\n", DecodeKernel_Name(kernel));
+			continue;
+		}
+
+		// warm up caches and page in the destination buffer
+		Read12BitLittleEndianSequenceWithKernel(kernel, source, sourceLength, destination, DECODE_ENTRIES);
+
+		double start = Benchmark_Now();
+		for(int round = 0 ; round < DECODE_ROUNDS ; ++round)
+			Read12BitLittleEndianSequenceWithKernel(kernel, source, sourceLength, destination, DECODE_ENTRIES);
+		double elapsed = Benchmark_Now() - start;
+
+		printf("decode kernel=%s entries=%d rounds=%d seconds=%.6f entries_per_second=%.0f\n",
+				DecodeKernel_Name(kernel), DECODE_ENTRIES, DECODE_ROUNDS, elapsed, (double)DECODE_ENTRIES * DECODE_ROUNDS / elapsed);
+
+		// the variant FileAllocationTable_Decode() uses, widening to 32 bits in registers
+		Read12BitLittleEndianSequenceWideWithKernel(kernel, source, sourceLength, wideDestination, DECODE_ENTRIES);
+		start = Benchmark_Now();
+		for(int round = 0 ; round < DECODE_ROUNDS ; ++round)
+			Read12BitLittleEndianSequenceWideWithKernel(kernel, source, sourceLength, wideDestination, DECODE_ENTRIES);
+		elapsed = Benchmark_Now() - start;
+
+		printf("decode kernel=%s width=32 entries=%d rounds=%d seconds=%.6f entries_per_second=%.0f\n",
+				DecodeKernel_Name(kernel), DECODE_ENTRIES, DECODE_ROUNDS, elapsed, (double)DECODE_ENTRIES * DECODE_ROUNDS / elapsed);
+	}
+
+	free(source);
+	free(destination);
+	free(wideDestination);
+}
+
+void Benchmark_DecodeTable()
+{
+	// large enough for DECODE_ENTRIES entries of any width
+	size_t sourceLength = DECODE_ENTRIES * 4;
+	uint8_t* source = malloc(sourceLength);
+	uint32_t* destination = malloc(DECODE_ENTRIES * sizeof(uint32_t));
+	if(source == NULL || destination == NULL)
+	{
+		printf("benchmark: out of memory\n");
+		exit(1);
+	}
+
+	for(size_t index = 0 ; index < sourceLength ; ++index)
+		source[index] = (uint8_t)(index * 167 + 13);
+
+	FATType types[] = { FAT12, FAT16, FAT32 };
+	for(size_t type = 0 ; type < sizeof(types) / sizeof(types[0]) ; ++type)
+	{
+		FileAllocationTable table;
+		FileAllocationTable_Initialize(&table, types[type], source, DECODE_ENTRIES);
+
+		// warm up caches and page in the destination buffer
+		FileAllocationTable_Decode(&table, 0, DECODE_ENTRIES, destination);
+
+		double start = Benchmark_Now();
+		for(int round = 0 ; round < DECODE_ROUNDS ; ++round)
+			FileAllocationTable_Decode(&table, 0, DECODE_ENTRIES, destination);
+		double elapsed = Benchmark_Now() - start;
+
+		printf("decode table=FAT%d entries=%d rounds=%d seconds=%.6f entries_per_second=%.0f\n",
+				types[type], DECODE_ENTRIES, DECODE_ROUNDS, elapsed, (double)DECODE_ENTRIES * DECODE_ROUNDS / elapsed);
+	}
+
+	free(source);
+	free(destination);
+}
+
+void Benchmark_Lookup()
+{
+	// FAT32 table with one chain hopping across the table, every other entry free
+	uint8_t* source = calloc(LOOKUP_ENTRIES, 4);
+	if(source == NULL)
+	{
+		printf("benchmark: out of memory\n");
+		exit(1);
+	}
+
+	FileAllocationTable table;
+	FileAllocationTable_Initialize(&table, FAT32, source, LOOKUP_ENTRIES);
+	size_t stride = (LOOKUP_ENTRIES - 2) / LOOKUP_CHAIN;
+	for(size_t link = 0 ; link < LOOKUP_CHAIN ; ++link)
+	{
+		size_t cluster = 2 + link * stride;
+		FileAllocationTable_Write(&table, cluster, link + 1 < LOOKUP_CHAIN ? cluster + stride : table.endOfChain);
+	}
+
+	for(int lazy = 0 ; lazy <= 1 ; ++lazy)
+	{
+		FATImage* disk = FATImage_Make();
+		disk->table = table;
+		disk->information.clusterCount = LOOKUP_ENTRIES - 2;
+		disk->imageFileDescriptor = -1;
+
+		double start = Benchmark_Now();
+		ClusterChain* chain = ClusterChain_Make();
+		if(!lazy)
+			FATImage_ReadFileAllocationTable(disk);
+		FATImage_ReadClusterChain(disk, 2, chain);
+		double elapsed = Benchmark_Now() - start;
+
+		printf("lookup mode=%s entries=%d chain=%zd seconds=%.6f\n", lazy ? "lazy" : "full", LOOKUP_ENTRIES, chain->length, elapsed);
+		ClusterChain_Free(chain);
+		FATImage_Free(disk);
+	}
+
+	free(source);
+}
+
+void Benchmark_Classify()
+{
+	// FAT32 table mixing free, last and linked clusters
+	uint8_t* source = malloc((size_t)LOOKUP_ENTRIES * 4);
+	if(source == NULL)
+	{
+		printf("benchmark: out of memory\n");
+		exit(1);
+	}
+
+	FileAllocationTable table;
+	FileAllocationTable_Initialize(&table, FAT32, source, LOOKUP_ENTRIES);
+	for(size_t index = 0 ; index < LOOKUP_ENTRIES ; ++index)
+	{
+		size_t kind = (index * 7919) % 8;
+		FileAllocationTable_Write(&table, index, kind == 0 ? 0 : kind == 1 ? table.endOfChain : (index * 104729) % (LOOKUP_ENTRIES - 2) + 2);
+	}
+
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t workers[] = { 1, 2, 4, online > 0 ? online : 1 };
+	double single = 0;
+	for(size_t run = 0 ; run < sizeof(workers) / sizeof(workers[0]) ; ++run)
+	{
+		FATImage* disk = FATImage_Make();
+		disk->table = table;
+		disk->information.clusterCount = LOOKUP_ENTRIES - 2;
+		disk->imageFileDescriptor = -1;
+		FATImage_SetWorkerCount(disk, workers[run]);
+		FATImage_AllocateClusters(disk, LOOKUP_ENTRIES);
+
+		double start = Benchmark_Now();
+		FATImage_DecodeAndClassifyClusters(disk);
+		double elapsed = Benchmark_Now() - start;
+		if(run == 0)
+			single = elapsed;
+
+		printf("classify workers=%zd online=%ld entries=%d seconds=%.6f speedup=%.2f\n", workers[run], online, LOOKUP_ENTRIES, elapsed, single / elapsed);
+		FATImage_Free(disk);
+	}
+
+	free(source);
+}
+
+void Benchmark_Chains()
+{
+	// FAT32 table of chains of 1 to 64 clusters, through runs of 4 contiguous clusters visited in a scrambled order
+	uint8_t* source = malloc((size_t)LOOKUP_ENTRIES * 4);
+	if(source == NULL)
+	{
+		printf("benchmark: out of memory\n");
+		exit(1);
+	}
+
+	FileAllocationTable table;
+	FileAllocationTable_Initialize(&table, FAT32, source, LOOKUP_ENTRIES);
+	size_t runs = (LOOKUP_ENTRIES - 4) / 4;
+	size_t clusters = runs * 4;
+	size_t chainLength = 0;
+	FileAllocationTable_Write(&table, 0, 0x0FFFFFF8);
+	FileAllocationTable_Write(&table, 1, table.endOfChain);
+	for(size_t step = 0 ; step < clusters ; ++step)
+	{
+		size_t cluster = 2 + (step / 4 * 7919) % runs * 4 + step % 4;
+		size_t next = 2 + ((step + 1) / 4 * 7919) % runs * 4 + (step + 1) % 4;
+		bool last = step + 1 == clusters || ++chainLength >= 1 + (step / 64) % 64;
+		FileAllocationTable_Write(&table, cluster, last ? table.endOfChain : next);
+		if(last)
+			chainLength = 0;
+	}
+	for(size_t cluster = clusters + 2 ; cluster < LOOKUP_ENTRIES ; ++cluster)
+		FileAllocationTable_Write(&table, cluster, 0);
+
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t workers[] = { 1, 2, 4, online > 0 ? online : 1 };
+	double single = 0;
+	for(size_t run = 0 ; run < sizeof(workers) / sizeof(workers[0]) ; ++run)
+	{
+		FATImage* disk = FATImage_Make();
+		disk->table = table;
+		disk->information.clusterCount = LOOKUP_ENTRIES - 2;
+		disk->imageFileDescriptor = -1;
+		FATImage_SetWorkerCount(disk, workers[run]);
+		FATImage_AllocateClusters(disk, LOOKUP_ENTRIES);
+
+		// the builder is timed together with classification, which it cannot run without
+		double start = Benchmark_Now();
+		FATImage_ReadClusterIndexSequenceAndCreateFileChains(disk);
+		double elapsed = Benchmark_Now() - start;
+		if(run == 0)
+			single = elapsed;
+
+		printf("chains workers=%zd online=%ld entries=%d chains=%zd seconds=%.6f speedup=%.2f\n",
+				workers[run], online, LOOKUP_ENTRIES, disk->clusterChainsLength, elapsed, single / elapsed);
+		FATImage_Free(disk);
+	}
+
+	free(source);
+}
+
+/* runs the dos_scandisk pipeline (with repairs) on a generated image, timing every phase */
+void Benchmark_PhasesOfImage(const char* label, ImageGeneratorOptions* options, FILE* output)
+{
+	char path[] = "/tmp/fat_benchmark_XXXXXX";
+	int fileDescriptor = mkstemp(path);
+	if(fileDescriptor == -1)
+	{
+		printf("benchmark: cannot create image file\n");
+		exit(1);
+	}
+	close(fileDescriptor);
+
+	double start = Benchmark_Now();
+	ssize_t files = ImageGenerator_Write(path, options);
+	if(files == -1)
+	{
+		printf("benchmark: cannot generate image: %s\n", strerror(errno));
+		unlink(path);
+		exit(1);
+	}
+	printf("generate image=%s clusters=%zd files=%zd fragmentation=%zd lost_chains=%zd cycles=%zd size_mismatches=%zd seconds=%.6f\n",
+			label, options->clusterCount, files, options->fragmentation, options->lostChains, options->cycles,
+			options->sizeMismatches, Benchmark_Now() - start);
+
+	size_t clusters = options->clusterCount;
+	Benchmark_ResetPeakRSS();
+	BenchmarkMark mark = Benchmark_Mark();
+	FATImage* disk = FATImage_InitializeWithMode(path, FATImageReadOnly, FATImageMapped);
+	if(disk == NULL)
+	{
+		printf("benchmark: cannot open generated image\n");
+		exit(1);
+	}
+	FATImage_SetOutput(disk, output, 0);
+	Benchmark_EndPhase(label, clusters, "Initialize", &mark);
+	if(!FATImage_UpdateDiskInformation(disk))
+	{
+		printf("benchmark: cannot read generated image\n");
+		exit(1);
+	}
+	Benchmark_EndPhase(label, clusters, "UpdateDiskInformation", &mark);
+	FATImage_ReadFileAllocationTable(disk);
+	Benchmark_EndPhase(label, clusters, "ReadFileAllocationTable", &mark);
+	FATImage_ReadDirectoryEntries(disk);
+	Benchmark_EndPhase(label, clusters, "ReadDirectoryEntries", &mark);
+	FATImage_PrintChainFindings(disk);
+	Benchmark_EndPhase(label, clusters, "PrintChainFindings", &mark);
+	FATImage_CompareFileAllocationTableCopies(disk);
+	Benchmark_EndPhase(label, clusters, "CompareFileAllocationTableCopies", &mark);
+	FATImage_PrintFileAllocationTableMismatches(disk);
+	Benchmark_EndPhase(label, clusters, "PrintFileAllocationTableMismatches", &mark);
+	FATImage_PrintUnreferencedClusters(disk);
+	Benchmark_EndPhase(label, clusters, "PrintUnreferencedClusters", &mark);
+	FATImage_PrintLostFiles(disk);
+	Benchmark_EndPhase(label, clusters, "PrintLostFiles", &mark);
+	FATImage_RecoverLostFiles(disk);
+	Benchmark_EndPhase(label, clusters, "RecoverLostFiles", &mark);
+	FATImage_PrintSizeInconsistencies(disk);
+	Benchmark_EndPhase(label, clusters, "PrintSizeInconsistencies", &mark);
+	FATImage_ResolveSizeInconsistencies(disk);
+	Benchmark_EndPhase(label, clusters, "ResolveSizeInconsistencies", &mark);
+	FATImage_MirrorFileAllocationTable(disk);
+	Benchmark_EndPhase(label, clusters, "MirrorFileAllocationTable", &mark);
+	FATImage_SaveChanges(disk);
+	Benchmark_EndPhase(label, clusters, "SaveChanges", &mark);
+	FATImage_Free(disk);
+	Benchmark_EndPhase(label, clusters, "Free", &mark);
+
+	char journalPath[sizeof(path) + sizeof(".journal")];
+	snprintf(journalPath, sizeof(journalPath), "%s.journal", path);
+	unlink(journalPath);
+	unlink(path);
+}
+
+/* generated FAT12, FAT16 and FAT32 images, or one image shaped by key=value arguments */
+void Benchmark_Phases(int argc, char** argv)
+{
+	FILE* output = fopen("/dev/null", "w");
+	if(output == NULL)
+	{
+		printf("benchmark: cannot open /dev/null\n");
+		exit(1);
+	}
+
+	//	clusters, sectors per cluster, files, fragmentation %, lost chains, cycles, size mismatches, seed
+	ImageGeneratorOptions custom = { 60000, 4, 6000, 20, 32, 4, 16, 1 };
+	bool customized = false;
+	for(int index = 1 ; index < argc ; ++index)
+	{
+		const char* value = strchr(argv[index], '=');
+		if(value == NULL)
+			continue;
+		size_t number = strtoul(value + 1, NULL, 10);
+		size_t keyLength = value - argv[index];
+		const char* keys[] = { "clusters", "sectors_per_cluster", "files", "fragmentation", "lost_chains", "cycles", "size_mismatches", "seed" };
+		size_t* fields[] = { &custom.clusterCount, &custom.sectorsPerCluster, &custom.fileCount, &custom.fragmentation, &custom.lostChains, &custom.cycles, &custom.sizeMismatches, NULL };
+		for(size_t key = 0 ; key < sizeof(keys) / sizeof(keys[0]) ; ++key)
+		{
+			if(strlen(keys[key]) != keyLength || strncmp(argv[index], keys[key], keyLength) != 0)
+				continue;
+			if(fields[key] != NULL)
+				*fields[key] = number;
+			else
+				custom.seed = number;
+			customized = true;
+		}
+	}
+
+	if(customized)
+	{
+		const char* label = custom.clusterCount < 4085 ? "FAT12" : custom.clusterCount < 65525 ? "FAT16" : "FAT32";
+		Benchmark_PhasesOfImage(label, &custom, output);
+	}
+	else
+	{
+		ImageGeneratorOptions fat12 = { 4000, 1, 400, 20, 8, 2, 4, 1 };
+		ImageGeneratorOptions fat16 = { 60000, 4, 6000, 20, 32, 4, 16, 2 };
+		ImageGeneratorOptions fat32 = { 1 << 21, 1, 100000, 20, 256, 8, 64, 3 };
+		Benchmark_PhasesOfImage("FAT12", &fat12, output);
+		Benchmark_PhasesOfImage("FAT16", &fat16, output);
+		Benchmark_PhasesOfImage("FAT32", &fat32, output);
+	}
+	fclose(output);
+}
+
+int main(int argc, char** argv)
+{
+	if(Benchmark_Selected(argc, argv, "decode"))
+		Benchmark_Decode();
+	if(Benchmark_Selected(argc, argv, "decode_table"))
+		Benchmark_DecodeTable();
+	if(Benchmark_Selected(argc, argv, "lookup"))
+		Benchmark_Lookup();
+	if(Benchmark_Selected(argc, argv, "classify"))
+		Benchmark_Classify();
+	if(Benchmark_Selected(argc, argv, "chains"))
+		Benchmark_Chains();
+	if(Benchmark_Selected(argc, argv, "phases"))
+		Benchmark_Phases(argc, argv);
+	return 0;
+}
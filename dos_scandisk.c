@@ -1,37 +1,272 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include "FATImage.h"
+#include "ThreadPool.h"
 
-#define NONE 0
-#define INFO 1
-#define DETAIL 2
-#define DEBUG 3
-int log_level = NONE;
+/* Options applied to every image checked */
+typedef struct
+{
+	bool sorted;
+	bool readOnly;
+	bool replay;
+	bool rollback;
+	bool stats;
+	size_t workers;
+	int logLevel;
+	FATImageBackend backend;
+	ReportFormat format;
+} ScanOptions;
 
-int main(int argc, char** argv)
+/* Output of one image of a batch, kept until every image before it has been printed */
+typedef struct
+{
+	char* path;
+	char* text;
+	size_t length;
+	bool done;
+} BatchResult;
+
+/* Images of a batch, checked on a thread pool and printed in input order */
+typedef struct
+{
+	ScanOptions* options;
+	BatchResult* results;
+	size_t resultsLength;
+	size_t resultsCapacity;
+	pthread_mutex_t lock;
+	pthread_cond_t resultDone;
+} Batch;
+
+/* writes an error record for a system error into output, before the image has a report of its own */
+void Scan_Error(FILE* output, ScanOptions* options, const char* context, int error)
+{
+	Report* report = Report_Make(output, options->format);
+	Report_AddError(report, context, error);
+	Report_Free(report);
+}
+
+void Scan(char* imageFile, ScanOptions* options, FILE* output, bool header)
 {
-	if(argc == 2)
+	// report unreadable images into output, so a batch keeps them in input order
+	Report* report = Report_Make(output, options->format);
+	if(header)
+		Report_AddNamed(report, ReportImage, imageFile, 0, 0);
+	bool readable = access(imageFile, R_OK) == 0;
+	if(!readable)
+		Report_AddError(report, NULL, errno);
+	Report_Free(report);
+	if(!readable)
+		return;
+
+	if(options->replay || options->rollback)
+	{
+		const char* outcomes[] = { "No journal", "Journal torn, discarded", options->rollback ? "Journal rolled back" : "Journal replayed", "Journal could not be applied" };
+		fprintf(output, "%s\n", outcomes[FATImage_ApplyJournal(imageFile, options->rollback)]);
+		return;
+	}
+
+	// finish repairs interrupted by a crash before scanning, so the scan never sees a half-written image
+	if(!options->readOnly && FATImage_ApplyJournal(imageFile, false) == JournalFailed)
 	{
-		FATImage* disk = FATImage_Initialize(argv[1]);
-		if(disk)
+		Scan_Error(output, options, "cannot apply journal", errno);
+		return;
+	}
+
+	// the image is only reopened for writing once a repair finds something to write
+	FATImage* disk = FATImage_InitializeWithMode(imageFile, FATImageReadOnly, options->backend);
+	if(disk == NULL)
+		Scan_Error(output, options, "cannot open image", errno);
+	else
+	{
+		FATImage_SetOutput(disk, output, options->logLevel);
+		FATImage_SetReportFormat(disk, options->format);
+		FATImage_SetWorkerCount(disk, options->workers);
+		FATImage_EnableStats(disk, options->stats);
+		if(!FATImage_UpdateDiskInformation(disk))
 		{
-			FATImage_UpdateDiskInformation(disk);
-			FATImage_ReadFileAllocationTable(disk);
-			FATImage_ReadDirectoryEntries(disk);
+			FATImage_Free(disk);
+			return;
+		}
+		FATImage_ReadFileAllocationTable(disk);
+		FATImage_ReadDirectoryEntries(disk);
 
+		FATImage_PrintChainFindings(disk);
+		FATImage_CompareFileAllocationTableCopies(disk);
+		FATImage_PrintFileAllocationTableMismatches(disk);
+		if(options->sorted)
+			FATImage_PrintUnreferencedClusterRanges(disk);
+		else
 			FATImage_PrintUnreferencedClusters(disk);
-			FATImage_PrintLostFiles(disk);
+		FATImage_PrintLostFiles(disk);
+		if(!options->readOnly)
 			FATImage_RecoverLostFiles(disk);
-			FATImage_PrintSizeInconsistencies(disk);
+		FATImage_PrintSizeInconsistencies(disk);
+		if(!options->readOnly)
+		{
 			FATImage_ResolveSizeInconsistencies(disk);
+			FATImage_MirrorFileAllocationTable(disk);
 			FATImage_SaveChanges(disk);
+		}
+		if(options->stats)
+			FATImage_PrintStats(disk);
 
-			FATImage_Free(disk);
+		FATImage_Free(disk);
+	}
+}
+
+void Batch_Add(Batch* batch, const char* path)
+{
+	if(batch->resultsLength == batch->resultsCapacity)
+	{
+		batch->resultsCapacity = batch->resultsCapacity > 0 ? 2 * batch->resultsCapacity : 64;
+		batch->results = realloc(batch->results, batch->resultsCapacity * sizeof(BatchResult));
+		if(batch->results == NULL)
+		{
+			printf("dos_scandisk: out of memory\n");
+			exit(1);
+		}
+	}
+
+	BatchResult* result = batch->results + batch->resultsLength++;
+	memset(result, 0, sizeof(BatchResult));
+	result->path = strdup(path);
+}
+
+/* adds one image per line of a list file, "-" for stdin */
+bool Batch_AddList(Batch* batch, const char* listFile)
+{
+	FILE* list = strcmp(listFile, "-") == 0 ? stdin : fopen(listFile, "r");
+	if(list == NULL)
+	{
+		printf("dos_scandisk: cannot open image list %s\n", listFile);
+		return false;
+	}
+
+	char* line = NULL;
+	size_t capacity = 0;
+	ssize_t length;
+	while((length = getline(&line, &capacity, list)) != -1)
+	{
+		while(length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+			line[--length] = '\0';
+		if(length > 0)
+			Batch_Add(batch, line);
+	}
+
+	free(line);
+	if(list != stdin)
+		fclose(list);
+	return true;
+}
+
+/* checks one image into its own buffer, so workers never share a stream */
+void Batch_Scan(void* context, size_t index)
+{
+	Batch* batch = context;
+	BatchResult* result = batch->results + index;
+
+	FILE* output = open_memstream(&(result->text), &(result->length));
+	Scan(result->path, batch->options, output, true);
+	fclose(output);
+
+	pthread_mutex_lock(&(batch->lock));
+	result->done = true;
+	pthread_cond_broadcast(&(batch->resultDone));
+	pthread_mutex_unlock(&(batch->lock));
+}
+
+void Batch_Run(Batch* batch, size_t jobs)
+{
+	pthread_mutex_init(&(batch->lock), NULL);
+	pthread_cond_init(&(batch->resultDone), NULL);
+	ThreadPool* pool = ThreadPool_Make(jobs);
+	ThreadPool_Start(pool, batch->resultsLength, Batch_Scan, batch);
+
+	// print each image as soon as it and every image before it are done
+	for(size_t index = 0 ; index < batch->resultsLength ; ++index)
+	{
+		BatchResult* result = batch->results + index;
+		pthread_mutex_lock(&(batch->lock));
+		while(!result->done)
+			pthread_cond_wait(&(batch->resultDone), &(batch->lock));
+		pthread_mutex_unlock(&(batch->lock));
+
+		fwrite(result->text, 1, result->length, stdout);
+		free(result->text);
+		free(result->path);
+	}
+
+	ThreadPool_Wait(pool);
+	ThreadPool_Free(pool);
+	pthread_cond_destroy(&(batch->resultDone));
+	pthread_mutex_destroy(&(batch->lock));
+	free(batch->results);
+}
+
+int main(int argc, char** argv)
+{
+	ScanOptions options = { .workers = 1, .backend = FATImageMapped, .format = ReportText };
+	Batch batch = { .options = &options };
+	bool batchMode = false;
+	size_t jobs = 0;
+	bool valid = true;
+	for(int index = 1 ; index < argc && valid ; ++index)
+	{
+		if(strcmp(argv[index], "--sorted") == 0)
+			options.sorted = true;
+		else if(strcmp(argv[index], "--workers") == 0 && index + 1 < argc)
+			options.workers = strtoul(argv[++index], NULL, 10);
+		else if(strcmp(argv[index], "--log-level") == 0 && index + 1 < argc)
+			options.logLevel = atoi(argv[++index]);
+		else if(strcmp(argv[index], "--stats") == 0)
+			options.stats = true;
+		else if(strcmp(argv[index], "--buffered") == 0)
+			options.backend = FATImageBuffered;
+		else if(strcmp(argv[index], "--read-only") == 0)
+			options.readOnly = true;
+		else if(strcmp(argv[index], "--replay") == 0)
+			options.replay = true;
+		else if(strcmp(argv[index], "--rollback") == 0)
+			options.rollback = true;
+		else if(strcmp(argv[index], "--format") == 0 && index + 1 < argc)
+		{
+			const char* format = argv[++index];
+			options.format = strcmp(format, "jsonl") == 0 ? ReportJSONLines : strcmp(format, "binary") == 0 ? ReportBinary : ReportText;
+			valid = options.format != ReportText || strcmp(format, "text") == 0;
 		}
+		else if(strcmp(argv[index], "--batch") == 0)
+			batchMode = true;
+		else if(strcmp(argv[index], "--jobs") == 0 && index + 1 < argc)
+			jobs = strtoul(argv[++index], NULL, 10);
+		else if(strcmp(argv[index], "--list") == 0 && index + 1 < argc)
+			valid = Batch_AddList(&batch, argv[++index]);
+		else if(strncmp(argv[index], "--", 2) == 0)
+			valid = false;
+		else
+			Batch_Add(&batch, argv[index]);
+	}
+
+	if(valid && batchMode)
+	{
+		Batch_Run(&batch, jobs);
+	}
+	else if(valid && batch.resultsLength == 1)
+	{
+		Scan(batch.results[0].path, &options, stdout, false);
+		free(batch.results[0].path);
+		free(batch.results);
 	}
 	else
 	{
-		printf("usage: dos_scandisk image_file\n");
+		printf("usage: dos_scandisk [--sorted] [--workers count] [--log-level 0-3] [--stats] [--buffered] [--format text|jsonl|binary] [--read-only | --replay | --rollback] image_file\n");
+		printf("       dos_scandisk --batch [--jobs count] [--list file] [options] [image_file ...]\n");
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -1,13 +1,13 @@
 #include "greatest/greatest.h"
+#include "ArenaTest.h"
+#include "BitsetTest.h"
 #include "ClusterChainTest.h"
 #include "FATImageTest.h"
+#include "FileAllocationTableTest.h"
 #include "HelpersTest.h"
-
-#define NONE 0
-#define INFO 1
-#define DETAIL 2
-#define DEBUG 3
-int log_level = NONE;
+#include "JournalTest.h"
+#include "ReportTest.h"
+#include "ThreadPoolTest.h"
 
 GREATEST_MAIN_DEFS();
 
@@ -15,9 +15,15 @@ int main(int argc, char** argv)
 {
     GREATEST_MAIN_BEGIN();
     
+    RUN_SUITE(ArenaTest);
+    RUN_SUITE(BitsetTest);
     RUN_SUITE(ClusterChainTest);
     RUN_SUITE(FATImageTest);
+    RUN_SUITE(FileAllocationTableTest);
     RUN_SUITE(HelpersTest);
+    RUN_SUITE(JournalTest);
+    RUN_SUITE(ReportTest);
+    RUN_SUITE(ThreadPoolTest);
 
     GREATEST_MAIN_END();
 }
\ No newline at end of file